@@ -50,6 +50,22 @@
  */
 #define UM_ATOMIC_AND_F(v, inc) __sync_and_and_fetch(v, inc)
 
+/**
+ * Atomic FETCH and bitwise OR
+ * @param[in]   v       Pointer to value
+ * @param[in]   inc     Value for bitwise op
+ * @return      Value before this operation
+ */
+#define UM_ATOMIC_F_OR(v, inc) __sync_fetch_and_or(v, inc)
+
+/**
+ * Atomic bitwise OR and FETCH
+ * @param[in]   v       Pointer to value
+ * @param[in]   inc     Value for bitwise op
+ * @return      Value after this operation
+ */
+#define UM_ATOMIC_OR_F(v, inc) __sync_or_and_fetch(v, inc)
+
 /**
  * Atomic FETCH and SUB
  * @param[in]   v       Pointer to value
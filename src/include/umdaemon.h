@@ -11,11 +11,20 @@
 #ifndef UMDAEMON_H
 #define UMDAEMON_H
 
+#include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 
 // Max daemon id/type size
 #define UMD_ID_MAX_SZ 30
+// Default log ring size (records per logging thread, power of 2)
+#define UMD_LOG_RING_SZ 64
+// Log ring size limits
+#define UMD_LOG_RING_MIN 8
+#define UMD_LOG_RING_MAX 4096
+// Inline formatted log message size (longer
+// messages are stored in a heap allocated buffer)
+#define UMD_LOG_MSG_MAX 256
 
 // UMD log level
 enum umd_log_level_t
@@ -26,14 +35,39 @@ enum umd_log_level_t
     UMD_LLT_DEBUG = 7
 };
 
+// UMD log sinks
+enum umd_log_sink_t
+{
+    UMD_LST_SYSLOG = 0x01,
+    UMD_LST_FILE = 0x02,
+    UMD_LST_STDOUT = 0x04
+};
+
+// UMD io events
+enum umd_io_event_t
+{
+    UMD_IO_READ = 0x01,
+    UMD_IO_WRITE = 0x02,
+    UMD_IO_ERROR = 0x04
+};
+
 // types
 typedef struct umdaemon umdaemon_t;
+typedef struct umd_logger umd_logger_t;
+typedef struct umd_reactor umd_reactor_t;
+typedef struct umd_timer umd_timer_t;
 // UMD on_terminate handler
 typedef void (*umd_on_terminate_t)(umdaemon_t *);
 // UMD on_init handler
 typedef void (*umd_on_init_t)(umdaemon_t *);
 // UMD process arguments handler
 typedef void (*umd_proc_args_t)(umdaemon_t *, int, char **);
+// UMD on_reload handler (SIGHUP)
+typedef void (*umd_on_reload_t)(umdaemon_t *);
+// UMD io handler (fd, UMD_IO_* events, user argument)
+typedef void (*umd_io_cb_t)(umdaemon_t *, int, int, void *);
+// UMD timer handler (timer, expirations, user argument)
+typedef void (*umd_timer_cb_t)(umdaemon_t *, umd_timer_t *, uint64_t, void *);
 
 // daemon descriptor
 struct umdaemon {
@@ -47,12 +81,25 @@ struct umdaemon {
     char *fqn;
     // UMD log level
     enum umd_log_level_t log_level;
+    // UMD log sinks (UMD_LST_*)
+    int log_sinks;
+    // log file (UMD_LST_FILE)
+    FILE *log_fp;
+    // log ring size (records per logging thread)
+    uint32_t log_ring_sz;
+    // async logger (NULL = synchronous logging)
+    umd_logger_t *logger;
+    // event loop (NULL = polling loop)
+    umd_reactor_t *reactor;
     // on_terminate handler
     umd_on_terminate_t on_terminate;
     // on_init handler
     umd_on_init_t on_init;
     // cmd_args handler
     umd_proc_args_t proc_args;
+    // on_reload handler (SIGHUP is handled by the
+    // event loop only if set before umd_start)
+    umd_on_reload_t on_reload;
     // user data
     void *data;
 };
@@ -106,6 +153,24 @@ int umd_set_id(umdaemon_t *umd, const char *id);
  */
 void umd_set_log_level(umdaemon_t *umd, enum umd_log_level_t ll);
 
+/**
+ * Set daemon log sinks (before daemon is started)
+ * @param[in]   umd                     Pointer to daemon descriptor
+ * @param[in]   sinks                   Log sinks (UMD_LST_* flags)
+ * @param[in]   file                    Log file path (UMD_LST_FILE)
+ * @return      0 for success
+ */
+int umd_set_log_sinks(umdaemon_t *umd, int sinks, const char *file);
+
+/**
+ * Set async log ring size (before daemon is started); size
+ * is rounded up to power of 2
+ * @param[in]   umd                     Pointer to daemon descriptor
+ * @param[in]   sz                      Records per logging thread
+ * @return      0 for success
+ */
+int umd_set_log_ring(umdaemon_t *umd, uint32_t sz);
+
 /**
  * Terminate daemon
  * @param[in]   umd                     Pointer to daemon descriptor
@@ -118,6 +183,64 @@ void umd_terminate(umdaemon_t *umd);
  */
 void umd_loop(umdaemon_t *umd);
 
+/**
+ * Register fd with daemon event loop; handler is called
+ * from the loop thread (available after umd_start)
+ * @param[in]   umd                     Pointer to daemon descriptor
+ * @param[in]   fd                      File descriptor
+ * @param[in]   events                  Events (UMD_IO_READ/UMD_IO_WRITE)
+ * @param[in]   cb                      Handler
+ * @param[in]   arg                     Handler user argument
+ * @return      0 for success
+ */
+int umd_io_add(umdaemon_t *umd, int fd, int events, umd_io_cb_t cb, void *arg);
+
+/**
+ * Change events of registered fd
+ * @param[in]   umd                     Pointer to daemon descriptor
+ * @param[in]   fd                      File descriptor
+ * @param[in]   events                  Events (UMD_IO_READ/UMD_IO_WRITE)
+ * @return      0 for success
+ */
+int umd_io_mod(umdaemon_t *umd, int fd, int events);
+
+/**
+ * Unregister fd from daemon event loop (fd is not closed); when
+ * called from other threads, handler might still be called once
+ * @param[in]   umd                     Pointer to daemon descriptor
+ * @param[in]   fd                      File descriptor
+ * @return      0 for success
+ */
+int umd_io_del(umdaemon_t *umd, int fd);
+
+/**
+ * Create daemon event loop timer
+ * @param[in]   umd                     Pointer to daemon descriptor
+ * @param[in]   delay                   Initial delay (ms)
+ * @param[in]   interval                Interval (ms), 0 = single shot
+ * @param[in]   cb                      Handler
+ * @param[in]   arg                     Handler user argument
+ * @return      Timer or NULL on error
+ */
+umd_timer_t *umd_timer_add(umdaemon_t *umd,
+                           uint64_t delay,
+                           uint64_t interval,
+                           umd_timer_cb_t cb,
+                           void *arg);
+
+/**
+ * Stop and free daemon event loop timer
+ * @param[in]   umd                     Pointer to daemon descriptor
+ * @param[in]   t                       Timer
+ */
+void umd_timer_del(umdaemon_t *umd, umd_timer_t *t);
+
+/**
+ * Wake up daemon event loop (thread and async-signal safe)
+ * @param[in]   umd                     Pointer to daemon descriptor
+ */
+void umd_wakeup(umdaemon_t *umd);
+
 /**
  * Process daemon command line arguments
  * @param[in]   argc                    Argument count
@@ -126,7 +249,11 @@ void umd_loop(umdaemon_t *umd);
 void umd_proc_args(int argc, char **argv);
 
 /**
- * Log message via syslog
+ * Log message; while daemon is running, message is formatted
+ * into per-thread ring buffer and written to log sinks by a
+ * background thread (dropped and counted if ring buffer is
+ * full; last 1/8 of the ring is reserved for errors), otherwise
+ * it is written synchronously
  * @param[in]   umd                     Pointer to daemon descriptor
  * @param[in]   level                   Log level
  * @param[in]   msg                     Log message
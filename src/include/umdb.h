@@ -12,10 +12,13 @@
 #define UMDB
 
 #include <sqlite3.h>
+#include <pthread.h>
+#include <stddef.h>
 
 // types
 typedef struct umdb_mngr_d umdb_mngrd_t;
 typedef struct umdb_uauth_d umdb_uauth_d_t;
+typedef struct umdb_acl_d umdb_acl_d_t;
 
 // sqlite query type
 enum query_type
@@ -26,12 +29,57 @@ enum query_type
     USER_CMD_DEL,
     USER_CMD_AUTH,
     USER_CMD_SPECIFIC_AUTH,
-    USER_GET
+    USER_GET,
+    DB_DATA_VERSION,
+    USER_LIST,
+    ACL_LIST
 };
 
+// busy handler timeout (ms)
+#define UMDB_BUSY_TIMEOUT 500
+
+// umdb_mngr_acl_list: acl table does not exist
+#define UMDB_ACL_NO_TABLE 5
+
+// current schema version (PRAGMA user_version)
+#define UMDB_SCHEMA_VERSION 2
+
+// number of query types (prepared statement cache size)
+#define UMDB_QUERY_NUM (ACL_LIST + 1)
+
+// hashed credential format:
+// $pbkdf2-sha256$<iterations>$<salt hex>$<hash hex>
+#define UMDB_CRED_PREFIX  "$pbkdf2-sha256$"
+#define UMDB_CRED_ITER    100000
+#define UMDB_CRED_SALT_SZ 16
+#define UMDB_CRED_HASH_SZ 32
+// max hashed credential length (with NUL)
+#define UMDB_CRED_MAX 160
+
+/**
+ * Credential verification method
+ *
+ * @param[in]   u       Username
+ * @param[in]   stored  Stored credential (hashed or plaintext)
+ * @param[in]   p       Password
+ * @param[in]   arg     User argument
+ * @return      1 if password matches
+ */
+typedef int (*umdb_cred_verify_t)(const char *u,
+                                  const char *stored,
+                                  const char *p,
+                                  void *arg);
+
 // db descriptor
 struct umdb_mngr_d {
     sqlite3 *db;
+    // prepared statements (per query type)
+    sqlite3_stmt *stmts[UMDB_QUERY_NUM];
+    // statement cache lock
+    pthread_mutex_t mtx;
+    // credential verification (umdb_cred_verify if NULL)
+    umdb_cred_verify_t verify;
+    void *verify_arg;
 };
 
 // user auth descriptor
@@ -42,9 +90,38 @@ struct umdb_uauth_d {
     const char *usr;
 };
 
+// ACL rule descriptor
+struct umdb_acl_d {
+    // username (NULL = any user)
+    const char *usr;
+    // user flags/group (-1 = any group)
+    int flags;
+    // topic pattern ('%u' and '%c' levels are
+    // replaced with username and client id)
+    const char *topic;
+    // allowed access (read = 1, write = 2, subscribe = 4;
+    // read also allows subscribe)
+    int access;
+};
+
+// user list callback (stored credential in pwd)
+typedef int (*umdb_ulist_cb_t)(const umdb_uauth_d_t *u, const char *pwd, void *arg);
+
+// ACL rule list callback
+typedef int (*umdb_acl_cb_t)(const umdb_acl_d_t *r, void *arg);
+
+int umdb_migrate(const char *db);
 umdb_mngrd_t *umdb_mngr_new(const char *db);
 void umdb_mngr_free(umdb_mngrd_t *m);
 int umdb_mngr_uauth(umdb_mngrd_t *m, umdb_uauth_d_t *res, const char *u, const char *p);
 int umdb_mngr_uget(umdb_mngrd_t *m, umdb_uauth_d_t *res, const char *u);
+int umdb_mngr_data_version(umdb_mngrd_t *m, int *v);
+int umdb_mngr_ulist(umdb_mngrd_t *m, umdb_ulist_cb_t cb, void *arg);
+int umdb_mngr_acl_list(umdb_mngrd_t *m, umdb_acl_cb_t cb, void *arg);
+void umdb_mngr_set_verify(umdb_mngrd_t *m, umdb_cred_verify_t f, void *arg);
+int umdb_user_add(const char *db, const char *u, const char *p, int flags);
+int umdb_cred_hash(const char *p, int iter, char *out, size_t out_sz);
+int umdb_cred_verify(const char *stored, const char *p);
+int umdb_cred_is_hashed(const char *stored);
 
 #endif /* ifndef UMDB */
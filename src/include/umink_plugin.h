@@ -12,6 +12,7 @@
 #define UMINK_PLUGIN
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <pthread.h>
 #include <utarray.h>
 #include <uthash.h>
@@ -25,8 +26,14 @@ typedef struct umplg_sh umplg_sh_t;
 typedef struct umplg_data_std_items umplg_data_std_items_t;
 typedef struct umplg_data_std_item umplg_data_std_item_t;
 typedef struct umplg_data_std umplg_data_std_t;
+typedef struct umplg_stdd_arena umplg_stdd_arena_t;
+typedef struct umplg_stdd_col umplg_stdd_col_t;
+typedef struct umplg_stdd_row umplg_stdd_row_t;
 typedef struct umplg_hkd umplg_hkd_t;
+typedef struct umplg_hk_slot umplg_hk_slot_t;
 typedef struct umplg_cmd_map umplg_cmd_map_t;
+typedef struct umplg_sigq_cfg umplg_sigq_cfg_t;
+typedef struct umplg_sigq umplg_sigq_t;
 
 // consts
 #define UMPLG_INIT_FN         "init"
@@ -34,6 +41,20 @@ typedef struct umplg_cmd_map umplg_cmd_map_t;
 #define UMPLG_CMD_HNDLR       "run"
 #define UMPLG_CMD_HNDLR_LOCAL "run_local"
 #define UMPLG_CMD_LST         "COMMANDS"
+#define UMPLG_FEAT_LST        "FEATURES"
+
+// size of direct-indexed hook dispatch table
+// (cmd ids outside of this range are
+// resolved via hooks hashmap)
+#define UMPLG_HK_TBL_SZ 64
+
+// plugin/signal handler features
+enum umplg_feat_t
+{
+    // standard data is read via umplg_stdd_* accessors
+    // (zero-copy rows are not converted to hashmaps)
+    UMPLG_FEAT_STDD_ZC = 0x01
+};
 
 // plugin CMD ids
 enum umplg_cmd_t
@@ -74,7 +95,8 @@ enum umplg_cmd_t
     CMD_MODBUS_READ_BITS = 33,
     CMD_NDPI_GET_STATS = 34,
     CMD_MQTT_PUBLISH = 35,
-    CMD_LUA_CALL = 36
+    CMD_LUA_CALL = 36,
+    CMD_LUA_STATS = 37
 };
 
 /**
@@ -129,6 +151,18 @@ typedef int (*umplg_shfn_run_t)(umplg_sh_t *shd,
                                 umplg_data_std_t *d_in,
                                 char **d_out,
                                 size_t *out_sz);
+/**
+ * Signal handler method (run, structured output)
+ *
+ * @param[in]       shd       Pointer to signal handler descriptor
+ * @param[in]       d_in      Pointer to plugin standard input data
+ * @param[in,out]   d_out     Output standard data (initialized by
+ *                            caller, rows are copied to its arena)
+ * @return      0 for success
+ */
+typedef int (*umplg_shfn_run_stdd_t)(umplg_sh_t *shd,
+                                     umplg_data_std_t *d_in,
+                                     umplg_data_std_t *d_out);
 /**
  * Signal handler method (term)
  *
@@ -137,11 +171,37 @@ typedef int (*umplg_shfn_run_t)(umplg_sh_t *shd,
  */
 typedef int (*umplg_shfn_term_t)(umplg_sh_t *shd);
 
-// string -> CMD id map
+// string -> CMD id map (gperf, umink_cmd_map.gperf)
 struct umplg_cmd_map {
-    int id;
     const char *name;
-    UT_hash_handle hh;
+    int id;
+};
+
+// async signal queue overflow policy
+enum umplg_sigq_policy_t
+{
+    // wait for free slot
+    UMPLG_SQ_BLOCK = 0,
+    // discard oldest queued signal
+    UMPLG_SQ_DROP_OLDEST = 1,
+    // discard new signal
+    UMPLG_SQ_DROP_NEW = 2
+};
+
+// async signal queue config
+struct umplg_sigq_cfg {
+    // number of worker threads
+    uint32_t workers;
+    // max number of queued signals
+    // (per queue)
+    uint32_t depth;
+    // overflow policy
+    enum umplg_sigq_policy_t policy;
+    // keep per-signal ordering
+    // (one queue per worker, signals
+    // are always processed by the same
+    // worker)
+    bool ordered;
 };
 
 // input data type for local interface
@@ -167,14 +227,85 @@ struct umplg_data_std_item {
     UT_hash_handle hh;
 };
 
-// standard data items
+// standard data items (must be zero initialized)
 struct umplg_data_std_items {
+    // hash index (name -> item)
     umplg_data_std_item_t *table;
+    // insertion ordered columns
+    // (index built on demand)
+    umplg_data_std_item_t **cols;
+    size_t cols_n;
+    size_t cols_cap;
+};
+
+// standard data value type
+enum umplg_stdd_type_t
+{
+    // string (value, sz)
+    UMPLG_STDD_STR = 0,
+    // 64bit integer (num.i)
+    UMPLG_STDD_INT = 1,
+    // double (num.d)
+    UMPLG_STDD_DBL = 2,
+    // boolean (num.b)
+    UMPLG_STDD_BOOL = 3,
+    // binary data (value, sz)
+    UMPLG_STDD_BLOB = 4
+};
+
+// standard data column (zero-copy, layout is
+// mirrored by plg_lua FFI definitions)
+struct umplg_stdd_col {
+    // column name
+    const char *name;
+    // column value (STR/BLOB); set to
+    // empty string for other types
+    const char *value;
+    // value size (bytes)
+    size_t sz;
+    // value type
+    enum umplg_stdd_type_t type;
+    // numeric value
+    union {
+        int64_t i;
+        double d;
+        bool b;
+    } num;
 };
 
-// standard data descriptor
+// standard data row (zero-copy, FFI mirrored)
+struct umplg_stdd_row {
+    // columns
+    umplg_stdd_col_t *cols;
+    // column count
+    size_t n;
+    // column capacity
+    size_t cap;
+};
+
+// standard data arena (bump allocator)
+struct umplg_stdd_arena {
+    // current buffer
+    char *buf;
+    // current buffer size
+    size_t sz;
+    // used bytes in current buffer
+    size_t used;
+    // heap allocated blocks
+    void *blks;
+};
+
+// standard data descriptor (leading fields
+// are FFI mirrored)
 struct umplg_data_std {
+    // rows (hashmaps)
     UT_array *items;
+    // rows (zero-copy, arena backed)
+    umplg_stdd_row_t *rows;
+    size_t rows_n;
+    size_t rows_cap;
+    // per-event arena
+    umplg_stdd_arena_t arena;
 };
 
 // input data descriptor
@@ -191,6 +322,8 @@ struct umplgd {
     char *name;
     /** Plugin type */
     int type;
+    /** Plugin features (UMPLG_FEAT_*) */
+    uint32_t features;
     /** Plugin cmd handler method */
     umplg_cmdh_t cmdh;
     /** Plugin cmd handler method (local) */
@@ -213,6 +346,17 @@ struct umplg_hkd {
     UT_hash_handle hh;
 };
 
+// hook dispatch table slot
+struct umplg_hk_slot {
+    // plugin pointer
+    umplgd_t *plgp;
+    // plugin features
+    uint32_t features;
+    // plugin cmd handlers
+    umplg_cmdh_t cmdh;
+    umplg_cmdh_t cmdh_l;
+};
+
 // signal handler descriptor
 struct umplg_sh {
     // signal id
@@ -221,9 +365,13 @@ struct umplg_sh {
     umplg_shfn_init_t init;
     umplg_shfn_run_t run;
     umplg_shfn_term_t term;
+    // structured output (optional)
+    umplg_shfn_run_stdd_t run_stdd;
     // extra args
     UT_array *args;
     bool running;
+    // handler features (UMPLG_FEAT_*)
+    uint32_t flags;
     // lock
     pthread_mutex_t mtx;
     // hashable
@@ -236,10 +384,22 @@ struct umplg_mngr {
     UT_array *plgs;
     // hashmap of plugin <-> hook mappings
     umplg_hkd_t *hooks;
+    // direct-indexed hook dispatch table
+    umplg_hk_slot_t hk_tbl[UMPLG_HK_TBL_SZ];
     // hasmap of registered signals
     umplg_sh_t *signals;
-    // cmd str -> cmd id
-    umplg_cmd_map_t *cmd_map;
+    // async signal queue
+    umplg_sigq_t *sigq;
+    // in-flight async signal producers
+    uint32_t sig_refs;
+    // producers drained (signalled by the last
+    // in-flight producer if sig_waiting is set)
+    pthread_mutex_t sig_mtx;
+    pthread_cond_t sig_idle;
+    uint8_t sig_waiting;
+    // async signals are no longer accepted
+    // (plugin manager is being freed)
+    uint8_t sig_closed;
     // configuration data
     void *cfg;
 };
@@ -289,12 +449,257 @@ int umplg_proc_signal(umplg_mngr_t *pm,
                       char **d_out,
                       size_t *out_sz);
 
+/**
+ * Process signal with structured output; output
+ * of handlers without structured output support
+ * is added as a single row with one unnamed column
+ *
+ * @param[in]       pm      Pointer to plugin manager
+ * @param[in]       s       Signal id
+ * @param[in]       d_in    Signal input data
+ * @param[in,out]   d_out   Output standard data (initialized
+ *                          by caller)
+ *
+ * @return      0 for success or error code
+ */
+int umplg_proc_signal_stdd(umplg_mngr_t *pm,
+                           const char *s,
+                           umplg_data_std_t *d_in,
+                           umplg_data_std_t *d_out);
+
+/**
+ * Start async signal processing (worker pool)
+ *
+ * @param[in]   pm      Pointer to plugin manager
+ * @param[in]   cfg     Async signal queue config
+ *
+ * @return      0 for success or error code
+ */
+int umplg_start_async(umplg_mngr_t *pm, const umplg_sigq_cfg_t *cfg);
+
+/**
+ * Stop async signal processing; signals that
+ * are already queued are processed before
+ * the workers are stopped
+ *
+ * @param[in]   pm      Pointer to plugin manager
+ */
+void umplg_stop_async(umplg_mngr_t *pm);
+
+/**
+ * Queue signal for async processing; input data is
+ * copied and signal output is discarded. If async
+ * processing was not started, signal is processed
+ * synchronously.
+ *
+ * @param[in]   pm      Pointer to plugin manager
+ * @param[in]   s       Signal id
+ * @param[in]   d_in    Signal input data
+ *
+ * @return      0 for success or error code
+ */
+int umplg_proc_signal_async(umplg_mngr_t *pm, const char *s, umplg_data_std_t *d_in);
+
 // standard data type
 int umplg_stdd_items_add(umplg_data_std_t *data, umplg_data_std_items_t *items);
 int umplg_stdd_item_add(umplg_data_std_items_t *items, umplg_data_std_item_t *item);
+int umplg_stdd_item_del(umplg_data_std_items_t *items, umplg_data_std_item_t *item);
 void umplg_stdd_init(umplg_data_std_t *data);
 void umplg_stdd_free(umplg_data_std_t *data);
 
+/**
+ * Get column by index (O(1) after first call); index
+ * is rebuilt after umplg_stdd_item_add/umplg_stdd_item_del
+ *
+ * @param[in]   items   Standard data items (row)
+ * @param[in]   i       Column index
+ * @return      Column or NULL if not found
+ */
+umplg_data_std_item_t *umplg_stdd_item_at(umplg_data_std_items_t *items, size_t i);
+
+/**
+ * Get column by name
+ *
+ * @param[in]   items   Standard data items (row)
+ * @param[in]   name    Column name
+ * @return      Column or NULL if not found
+ */
+umplg_data_std_item_t *umplg_stdd_item_find(umplg_data_std_items_t *items,
+                                            const char *name);
+
+/**
+ * Init standard data with caller provided arena buffer;
+ * buffer must outlive standard data, additional memory
+ * is allocated from heap if needed; buffer start is
+ * rounded up to max_align_t alignment (usable size is
+ * reduced by the same amount)
+ *
+ * @param[in]   data    Standard data
+ * @param[in]   buf     Initial arena buffer
+ * @param[in]   sz      Initial arena buffer size
+ */
+void umplg_stdd_init_buf(umplg_data_std_t *data, void *buf, size_t sz);
+
+/**
+ * Add new zero-copy row; row pointer is valid
+ * until next row is added
+ *
+ * @param[in]   data    Standard data
+ * @param[in]   cols    Expected column count (hint)
+ * @return      New row or NULL on error
+ */
+umplg_stdd_row_t *umplg_stdd_row_new(umplg_data_std_t *data, size_t cols);
+
+/**
+ * Add column to zero-copy row; name and value are
+ * not copied and must outlive standard data
+ *
+ * @param[in]   data    Standard data
+ * @param[in]   row     Row returned by umplg_stdd_row_new
+ * @param[in]   name    Column name
+ * @param[in]   value   Column value
+ * @param[in]   sz      Column value size
+ * @return      0 for success
+ */
+int umplg_stdd_col_add(umplg_data_std_t *data,
+                       umplg_stdd_row_t *row,
+                       const char *name,
+                       const char *value,
+                       size_t sz);
+
+/**
+ * Add column to zero-copy row; name and value
+ * are copied to standard data arena
+ *
+ * @param[in]   data    Standard data
+ * @param[in]   row     Row returned by umplg_stdd_row_new
+ * @param[in]   name    Column name
+ * @param[in]   value   Column value
+ * @param[in]   sz      Column value size
+ * @return      0 for success
+ */
+int umplg_stdd_col_add_copy(umplg_data_std_t *data,
+                            umplg_stdd_row_t *row,
+                            const char *name,
+                            const char *value,
+                            size_t sz);
+
+/**
+ * Add typed column to zero-copy row
+ *
+ * @param[in]   data    Standard data
+ * @param[in]   row     Row returned by umplg_stdd_row_new
+ * @param[in]   name    Column name (not copied)
+ * @param[in]   v       Column value
+ * @return      0 for success
+ */
+int umplg_stdd_col_add_int(umplg_data_std_t *data,
+                           umplg_stdd_row_t *row,
+                           const char *name,
+                           int64_t v);
+int umplg_stdd_col_add_dbl(umplg_data_std_t *data,
+                           umplg_stdd_row_t *row,
+                           const char *name,
+                           double v);
+int umplg_stdd_col_add_bool(umplg_data_std_t *data,
+                            umplg_stdd_row_t *row,
+                            const char *name,
+                            bool v);
+
+/**
+ * Add binary column to zero-copy row; value
+ * is not copied and must outlive standard data
+ *
+ * @param[in]   data    Standard data
+ * @param[in]   row     Row returned by umplg_stdd_row_new
+ * @param[in]   name    Column name (not copied)
+ * @param[in]   v       Column value
+ * @param[in]   sz      Column value size
+ * @return      0 for success
+ */
+int umplg_stdd_col_add_blob(umplg_data_std_t *data,
+                            umplg_stdd_row_t *row,
+                            const char *name,
+                            const void *v,
+                            size_t sz);
+
+/**
+ * Typed column accessors; values are converted
+ * if column type does not match
+ *
+ * @param[in]   col     Column
+ * @return      Column value
+ */
+int64_t umplg_stdd_col_int(const umplg_stdd_col_t *col);
+double umplg_stdd_col_dbl(const umplg_stdd_col_t *col);
+bool umplg_stdd_col_bool(const umplg_stdd_col_t *col);
+
+/**
+ * Get column value as NUL terminated string; numeric
+ * values are formatted to buffer (INT as decimal, DBL
+ * as "%.14g"), BOOL values are "true" or "false"
+ *
+ * @param[in]   col     Column
+ * @param[in]   buf     Buffer for numeric values
+ * @param[in]   sz      Buffer size
+ * @return      String value (STR/BLOB values are returned
+ *              as is and might not be NUL terminated)
+ */
+const char *umplg_stdd_col_str(const umplg_stdd_col_t *col, char *buf, size_t sz);
+
+/**
+ * Get row count (hashmap rows first, zero-copy rows after)
+ *
+ * @param[in]   data    Standard data
+ * @return      Row count
+ */
+size_t umplg_stdd_rows(umplg_data_std_t *data);
+
+/**
+ * Get column count for specific row
+ *
+ * @param[in]   data    Standard data
+ * @param[in]   r       Row index
+ * @return      Column count
+ */
+size_t umplg_stdd_row_sz(umplg_data_std_t *data, size_t r);
+
+/**
+ * Get column
+ *
+ * @param[in]   data    Standard data
+ * @param[in]   r       Row index
+ * @param[in]   c       Column index
+ * @param[out]  col     Column
+ * @return      0 for success
+ */
+int umplg_stdd_col_get(umplg_data_std_t *data, size_t r, size_t c, umplg_stdd_col_t *col);
+
+/**
+ * Get column with NUL terminated value; zero-copy values
+ * are copied and numeric values are formatted to
+ * standard data arena (valid until data is freed)
+ *
+ * @param[in]   data    Standard data
+ * @param[in]   r       Row index
+ * @param[in]   c       Column index
+ * @param[out]  col     Column
+ * @return      0 for success
+ */
+int umplg_stdd_col_get_str(umplg_data_std_t *data,
+                           size_t r,
+                           size_t c,
+                           umplg_stdd_col_t *col);
+
+/**
+ * Convert zero-copy rows to hashmap rows (for plugins
+ * and signal handlers without UMPLG_FEAT_STDD_ZC); hashmap
+ * values are NUL terminated, binary values are truncated
+ *
+ * @param[in]   data    Standard data
+ */
+void umplg_stdd_legacy(umplg_data_std_t *data);
+
 // cmd id
 int umplg_get_cmd_id(umplg_mngr_t *pm, const char *cmd_str);
 
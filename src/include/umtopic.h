@@ -0,0 +1,117 @@
+/*
+ *               _____  ____ __
+ *   __ ____ _  /  _/ |/ / //_/
+ *  / // /  ' \_/ //    / ,<
+ *  \_,_/_/_/_/___/_/|_/_/|_|
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#ifndef UMTOPIC
+#define UMTOPIC
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// types
+typedef struct umtopic_node umtopic_node_t;
+typedef struct umtopic_trie umtopic_trie_t;
+typedef struct umtopic_subst umtopic_subst_t;
+
+/**
+ * Topic match callback
+ *
+ * @param[in]   val     Value attached to matched filter
+ * @param[in]   arg     User argument
+ */
+typedef void (*umtopic_match_cb_t)(void *val, void *arg);
+
+// filter level substitution (filter level
+// equal to key matches topic level equal to val)
+struct umtopic_subst {
+    // filter level (e.g. "%u")
+    const char *key;
+    // substituted value (e.g. username)
+    const char *val;
+};
+
+// topic filter trie (MQTT topic filter semantics,
+// '+' single level and '#' multi level wildcards)
+struct umtopic_trie {
+    // root node
+    umtopic_node_t *root;
+    // number of filters
+    size_t n;
+};
+
+/**
+ * Create new topic trie
+ *
+ * @return      New trie or NULL on error
+ */
+umtopic_trie_t *umtopic_new(void);
+
+/**
+ * Free topic trie (attached values are not freed)
+ *
+ * @param[in]   t       Topic trie
+ */
+void umtopic_free(umtopic_trie_t *t);
+
+/**
+ * Validate topic filter
+ *
+ * @param[in]   filter  Topic filter
+ * @return      true if filter is valid
+ */
+bool umtopic_filter_valid(const char *filter);
+
+/**
+ * Add topic filter to trie
+ *
+ * @param[in]   t       Topic trie
+ * @param[in]   filter  Topic filter (copied)
+ * @param[in]   val     Value attached to filter (not copied)
+ * @return      0 for success
+ */
+int umtopic_add(umtopic_trie_t *t, const char *filter, void *val);
+
+/**
+ * Match topic against all filters in trie
+ *
+ * @param[in]   t       Topic trie
+ * @param[in]   topic   Topic name (not NUL terminated)
+ * @param[in]   sz      Topic name size
+ * @param[in]   cb      Callback method (called for each match)
+ * @param[in]   arg     Callback user argument
+ * @return      Number of matched filters
+ */
+size_t umtopic_match(umtopic_trie_t *t,
+                     const char *topic,
+                     size_t sz,
+                     umtopic_match_cb_t cb,
+                     void *arg);
+
+/**
+ * Match topic against all filters in trie, with
+ * filter level substitution
+ *
+ * @param[in]   t       Topic trie
+ * @param[in]   topic   Topic name (not NUL terminated)
+ * @param[in]   sz      Topic name size
+ * @param[in]   subst   Level substitutions
+ * @param[in]   subst_n Number of level substitutions
+ * @param[in]   cb      Callback method (called for each match)
+ * @param[in]   arg     Callback user argument
+ * @return      Number of matched filters
+ */
+size_t umtopic_match_subst(umtopic_trie_t *t,
+                           const char *topic,
+                           size_t sz,
+                           const umtopic_subst_t *subst,
+                           size_t subst_n,
+                           umtopic_match_cb_t cb,
+                           void *arg);
+
+#endif /* ifndef UMTOPIC */
@@ -0,0 +1,107 @@
+/*
+ *               _____  ____ __
+ *   __ ____ _  /  _/ |/ / //_/
+ *  / // /  ' \_/ //    / ,<
+ *  \_,_/_/_/_/___/_/|_/_/|_|
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#ifndef UMTWHEEL
+#define UMTWHEEL
+
+#include <stddef.h>
+#include <stdint.h>
+
+// wheel levels and slots per level (64^4 ticks
+// range, longer timers are cascaded again)
+#define UMTW_LVL_BITS 6
+#define UMTW_LVL_SZ   (1 << UMTW_LVL_BITS)
+#define UMTW_LVLS     4
+
+// types
+typedef struct umtw_timer umtw_timer_t;
+typedef struct umtw umtw_t;
+
+/**
+ * Timer expired callback
+ *
+ * @param[in]   t       Expired timer (already removed from wheel)
+ * @param[in]   arg     User argument
+ */
+typedef void (*umtw_cb_t)(umtw_timer_t *t, void *arg);
+
+// timer (embedded in user struct, zero initialized)
+struct umtw_timer {
+    // slot list (NULL = not scheduled)
+    umtw_timer_t *next;
+    umtw_timer_t *prev;
+    // expiry (absolute tick)
+    uint64_t expires;
+};
+
+// hierarchical timer wheel (not thread safe)
+struct umtw {
+    // last processed tick
+    uint64_t now;
+    // number of scheduled timers
+    size_t n;
+    // slot list heads
+    umtw_timer_t slots[UMTW_LVLS][UMTW_LVL_SZ];
+};
+
+/**
+ * Create new timer wheel
+ *
+ * @param[in]   now     Current tick
+ * @return      New timer wheel or NULL on error
+ */
+umtw_t *umtw_new(uint64_t now);
+
+/**
+ * Free timer wheel (scheduled timers are not freed)
+ *
+ * @param[in]   tw      Timer wheel
+ */
+void umtw_free(umtw_t *tw);
+
+/**
+ * Schedule timer (rescheduled if already scheduled)
+ *
+ * @param[in]   tw      Timer wheel
+ * @param[in]   t       Timer
+ * @param[in]   expires Expiry (absolute tick, past
+ *                      expiry fires on next tick)
+ */
+void umtw_add(umtw_t *tw, umtw_timer_t *t, uint64_t expires);
+
+/**
+ * Remove timer from wheel
+ *
+ * @param[in]   tw      Timer wheel
+ * @param[in]   t       Timer
+ */
+void umtw_del(umtw_t *tw, umtw_timer_t *t);
+
+/**
+ * Advance timer wheel and fire expired timers
+ *
+ * @param[in]   tw      Timer wheel
+ * @param[in]   now     Current tick
+ * @param[in]   cb      Callback method (called for each expired timer)
+ * @param[in]   arg     Callback user argument
+ * @return      Number of expired timers
+ */
+size_t umtw_advance(umtw_t *tw, uint64_t now, umtw_cb_t cb, void *arg);
+
+/**
+ * Get number of ticks until wheel needs to be advanced
+ * (next expiry or cascade)
+ *
+ * @param[in]   tw      Timer wheel
+ * @return      Number of ticks (1 - UMTW_LVL_SZ)
+ */
+uint64_t umtw_next(umtw_t *tw);
+
+#endif /* ifndef UMTWHEEL */
@@ -11,6 +11,8 @@
 #include <umink_pkg_config.h>
 #include <umink_plugin.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include <luaconf.h>
 #include <lua.h>
 #include <lualib.h>
@@ -19,46 +21,127 @@
 /*********/
 /* Types */
 /*********/
+// column (legacy); value is always NUL terminated
 typedef struct {
     const char *key;
     const char *value;
 } mink_cdata_column_t;
 
+// column (sized); value is binary safe and
+// not NUL terminated (use ffi.string(value, sz))
+typedef struct {
+    const char *key;
+    const char *value;
+    size_t sz;
+} mink_cdata_column_l_t;
+
+#ifdef HAVE_LUAJIT_H
+/**************************/
+/* LuaJIT FFI definitions */
+/**************************/
+// std data layout (keep in sync with umink_plugin.h);
+// cdata is valid only while handler is running
+static const char *MINK_LUA_FFI =
+    "local ffi = require('ffi')\n"
+    "ffi.cdef[[\n"
+    "int mink_strcmp(const char *s1, const char *s2) asm(\"strcmp\");\n"
+    "typedef struct {\n"
+    "    const char *name;\n"
+    "    const char *value;\n"
+    "    size_t sz;\n"
+    "    int type;\n"
+    "    union { int64_t i; double d; bool b; } num;\n"
+    "} mink_stdd_col_t;\n"
+    "typedef struct {\n"
+    "    const mink_stdd_col_t *cols;\n"
+    "    size_t n;\n"
+    "    size_t cap;\n"
+    "} mink_stdd_row_t;\n"
+    "typedef struct {\n"
+    "    void *items;\n"
+    "    const mink_stdd_row_t *rows;\n"
+    "    size_t rows_n;\n"
+    "} mink_stdd_t;\n"
+    "]]\n"
+    "local C = ffi.C\n"
+    // col:str() copies value to lua string
+    "ffi.metatype('mink_stdd_col_t', { __index = {\n"
+    "    str = function(c) return ffi.string(c.value, c.sz) end } })\n"
+    // row:get(name) finds column (no copy)
+    "ffi.metatype('mink_stdd_row_t', { __index = {\n"
+    "    get = function(r, k)\n"
+    "        for i = 0, tonumber(r.n) - 1 do\n"
+    "            if C.mink_strcmp(r.cols[i].name, k) == 0 then return r.cols[i] end\n"
+    "        end\n"
+    "    end } })\n"
+    "local ct = ffi.typeof('const mink_stdd_t *')\n"
+    "local get = M.get_args_ffi\n"
+    "M.get_args_ffi = function()\n"
+    "    local d = get()\n"
+    "    if type(d) == 'userdata' then return ffi.cast(ct, d) end\n"
+    "    return d\n"
+    "end\n";
+
+/*********************/
+/* LuaJIT FFI (init) */
+/*********************/
+int
+mink_lua_ffi_init(lua_State *L)
+{
+    if (luaL_loadbuffer(L, MINK_LUA_FFI, strlen(MINK_LUA_FFI), "=mink_ffi") ||
+        lua_pcall(L, 0, 0, 0)) {
+        return 1;
+    }
+    // FFI wrapper installed (cdata can be returned)
+    lua_pushstring(L, "mink_ffi");
+    lua_pushboolean(L, 1);
+    lua_settable(L, LUA_REGISTRYINDEX);
+    return 0;
+}
+#endif
+
 /**********/
 /* Signal */
 /**********/
-char *
-mink_lua_signal(const char *s, const char *d, void *md)
+static char *
+mink_lua_signal_l(const char *s, const char *d, size_t d_sz, void *md, size_t *out_sz)
 {
     // plugin manager
     umplg_mngr_t *pm = md;
-    // check signal
-    if (!s) {
-        return strdup("<SIGNAL UNDEFINED>");
-    }
-    // create std data
+    // create std data (zero-copy, stack arena)
+    char arena[128];
     umplg_data_std_t e_d = { .items = NULL };
-    umplg_data_std_items_t items = { .table = NULL };
-    umplg_data_std_item_t item = { .name = "", .value = (char *)(d ? d : "") };
-    // init std data
-    umplg_stdd_init(&e_d);
-    umplg_stdd_item_add(&items, &item);
-    umplg_stdd_items_add(&e_d, &items);
+    umplg_stdd_init_buf(&e_d, arena, sizeof(arena));
+    umplg_stdd_row_t *row = umplg_stdd_row_new(&e_d, 1);
+    umplg_stdd_col_add(&e_d, row, "", d, d_sz);
     // output buffer (allocated in signal handler)
     char *b = NULL;
     size_t sz = 0;
     // process signal
     if (umplg_proc_signal(pm, s, &e_d, &b, &sz) == 0) {
         // cleanup
-        HASH_CLEAR(hh, items.table);
         umplg_stdd_free(&e_d);
+        // size includes NUL terminator
+        *out_sz = (b != NULL && sz > 0 ? sz - 1 : 0);
         return b;
     }
     // cleanup
-    HASH_CLEAR(hh, items.table);
     umplg_stdd_free(&e_d);
     // error
-    return strdup("");
+    *out_sz = 0;
+    return NULL;
+}
+
+char *
+mink_lua_signal(const char *s, const char *d, void *md)
+{
+    // check signal
+    if (!s) {
+        return strdup("<SIGNAL UNDEFINED>");
+    }
+    size_t sz = 0;
+    char *b = mink_lua_signal_l(s, d, (d ? strlen(d) : 0), md, &sz);
+    return (b != NULL ? b : strdup(""));
 }
 
 /*****************************/
@@ -67,13 +150,8 @@ mink_lua_signal(const char *s, const char *d, void *md)
 size_t
 mink_lua_cmd_data_sz(void *p)
 {
-    if (p == NULL) {
-        return 0;
-    }
-    // cast (unsafe) to standard plugin data type
-    umplg_data_std_t *d = p;
     // row count
-    return utarray_len(d->items);
+    return umplg_stdd_rows(p);
 }
 
 /**************************************************/
@@ -82,16 +160,8 @@ mink_lua_cmd_data_sz(void *p)
 size_t
 mink_lua_cmd_data_row_sz(const int r, void *p)
 {
-    // cast (unsafe) to standard plugin data type
-    umplg_data_std_t *d = p;
-    // verify row index
-    if (r >= utarray_len(d->items)) {
-        return 0;
-    }
-    // items elem at index
-    umplg_data_std_items_t *items = utarray_eltptr(d->items, r);
     // column count for row at index
-    return HASH_COUNT(items->table);
+    return umplg_stdd_row_sz(p, r);
 }
 
 /********************************/
@@ -100,35 +170,30 @@ mink_lua_cmd_data_row_sz(const int r, void *p)
 mink_cdata_column_t
 mink_lua_cmd_data_get_column(const int r, const int c, void *p)
 {
-    // get row count
-    size_t rc = mink_lua_cmd_data_sz(p);
-    // sanity check (rows)
-    if (rc <= r) {
+    // get column at index (NUL terminated
+    // copy of zero-copy values)
+    umplg_stdd_col_t col;
+    if (umplg_stdd_col_get_str(p, r, c, &col)) {
         mink_cdata_column_t cdata = { 0 };
         return cdata;
     }
-    // cast (unsafe) to standard plugin data type
-    umplg_data_std_t *d = p;
-    // get row at index
-    umplg_data_std_items_t *row = utarray_eltptr(d->items, r);
-    // sanity check (columns)
-    if (HASH_COUNT(row->table) <= c) {
-        mink_cdata_column_t cdata = { 0 };
+    mink_cdata_column_t cdata = { col.name, col.value };
+    return cdata;
+}
+
+/****************************************/
+/* Get plugin data column value (sized) */
+/****************************************/
+mink_cdata_column_l_t
+mink_lua_cmd_data_get_column_l(const int r, const int c, void *p)
+{
+    // get column at index (binary safe)
+    umplg_stdd_col_t col;
+    if (umplg_stdd_col_get(p, r, c, &col)) {
+        mink_cdata_column_l_t cdata = { 0 };
         return cdata;
     }
-    // get column at index
-    umplg_data_std_item_t *column = NULL;
-    int i = 0;
-    for (column = row->table; column != NULL; column = column->hh.next) {
-        if (i == c) {
-            // return column value
-            mink_cdata_column_t cdata = { column->name, column->value };
-            return cdata;
-        }
-        ++i;
-    }
-
-    mink_cdata_column_t cdata = { 0 };
+    mink_cdata_column_l_t cdata = { col.name, col.value, col.sz };
     return cdata;
 }
 
@@ -149,8 +214,7 @@ mink_lua_free_res(void *p)
 void *
 mink_lua_new_cmd_data()
 {
-    umplg_data_std_t *d = malloc(sizeof(umplg_data_std_t));
-    d->items = NULL;
+    umplg_data_std_t *d = calloc(1, sizeof(umplg_data_std_t));
     umplg_stdd_init(d);
     return d;
 }
@@ -175,17 +239,10 @@ mink_lua_cmd_call(void *md, int argc, const char **args, void *out)
     umplg_data_std_t *d = out;
     // get command id
     int cmd_id = umplg_get_cmd_id(pm, args[0]);
-    // cmd arguments
+    // cmd arguments (zero-copy rows)
     for (int i = 1; i < argc; i++) {
-        // column map
-        umplg_data_std_items_t cmap = { .table = NULL };
-        // insert columns
-        umplg_data_std_item_t item = { .name = "", .value = (char *)args[i] };
-        umplg_stdd_item_add(&cmap, &item);
-        // add row
-        umplg_stdd_items_add(d, &cmap);
-        // cleanup
-        HASH_CLEAR(hh, cmap.table);
+        umplg_stdd_row_t *row = umplg_stdd_row_new(d, 1);
+        umplg_stdd_col_add(d, row, "", args[i], strlen(args[i]));
     }
     // plugin input data
     umplg_idata_t idata = { UMPLG_DT_STANDARD, d };
@@ -196,62 +253,423 @@ mink_lua_cmd_call(void *md, int argc, const char **args, void *out)
 
 }
 
-/************/
-/* get_args */
-/************/
-int
-mink_lua_get_args(lua_State *L)
+// integral numbers are passed as integers
+static bool
+mink_lua_is_int(lua_Number n)
 {
-    // get std data
-    lua_pushstring(L, "mink_stdd");
-    lua_gettable(L, LUA_REGISTRYINDEX);
-    umplg_data_std_t *d = lua_touserdata(L, -1);
-    size_t sz = mink_lua_cmd_data_sz(d);
+    return n >= -9007199254740992.0 && n <= 9007199254740992.0 &&
+           (lua_Number)(int64_t)n == n;
+}
 
-    // lua table
-    lua_newtable(L);
+/*********************************/
+/* Standard data column to value */
+/*********************************/
+static void
+mink_lua_push_col(lua_State *L, const umplg_stdd_col_t *c)
+{
+    switch (c->type) {
+    case UMPLG_STDD_INT:
+        lua_pushnumber(L, (lua_Number)c->num.i);
+        break;
+    case UMPLG_STDD_DBL:
+        lua_pushnumber(L, c->num.d);
+        break;
+    case UMPLG_STDD_BOOL:
+        lua_pushboolean(L, c->num.b);
+        break;
+    default:
+        lua_pushlstring(L, c->value, c->sz);
+        break;
+    }
+}
 
+/******************************/
+/* Standard data to lua table */
+/******************************/
+static void
+mink_lua_push_stdd(lua_State *L, umplg_data_std_t *d)
+{
+    // row count
+    size_t sz = umplg_stdd_rows(d);
+    // lua table
+    lua_createtable(L, sz, 0);
     // loop result data (rows)
-    for (int i = 0; i < sz; i++) {
+    for (size_t i = 0; i < sz; i++) {
         // table key (array)
         lua_pushnumber(L, i + 1);
-
-        // create table row
-        lua_newtable(L);
-
         // get column count
-        size_t sz_c = mink_lua_cmd_data_row_sz(i, d);
+        size_t sz_c = umplg_stdd_row_sz(d, i);
+        // create table row
+        lua_createtable(L, 0, sz_c);
         // loop columns
-        for (int j = 0; j < sz_c; j++) {
+        for (size_t j = 0; j < sz_c; j++) {
             // get column key/value
-            mink_cdata_column_t c = mink_lua_cmd_data_get_column(i, j, d);
-            // add column to lua table
-            if (c.value != NULL) {
-                int k = 1;
-                // update key, if not null
-                if (c.key != NULL && strlen(c.key) > 0) {
-                    // k = ffi.string(c.key)
-                    lua_pushstring(L, c.key);
-
-                } else {
-                    // k = 1
-                    lua_pushnumber(L, k);
-                }
-
-                // add value and add table column
-                lua_pushstring(L, c.value);
-                lua_settable(L, -3);
+            umplg_stdd_col_t c;
+            if (umplg_stdd_col_get(d, i, j, &c)) {
+                continue;
             }
-        }
+            // column name, if not empty
+            if (c.name != NULL && c.name[0] != '\0') {
+                lua_pushstring(L, c.name);
 
+            } else {
+                // k = 1
+                lua_pushnumber(L, 1);
+            }
+            // add value (native lua type) and add table column
+            mink_lua_push_col(L, &c);
+            lua_settable(L, -3);
+        }
         // add table row
         lua_settable(L, -3);
     }
+}
+
+/**********************************/
+/* Lua value to standard data row */
+/**********************************/
+// add lua value as column (name and value are copied,
+// lua values do not outlive handler)
+static int
+mink_lua_col_add(lua_State *L, int idx, umplg_data_std_t *d, umplg_stdd_row_t *row, const char *n)
+{
+    switch (lua_type(L, idx)) {
+    case LUA_TSTRING: {
+        size_t l = 0;
+        const char *v = lua_tolstring(L, idx, &l);
+        return umplg_stdd_col_add_copy(d, row, n, v, l);
+    }
+    case LUA_TNUMBER:
+    case LUA_TBOOLEAN:
+        break;
+    default:
+        // unsupported type, skip
+        return 0;
+    }
+    if (umplg_stdd_col_add_copy(d, row, n, "", 0)) {
+        return 1;
+    }
+    // set value type
+    umplg_stdd_col_t *c = &row->cols[row->n - 1];
+    if (lua_type(L, idx) == LUA_TBOOLEAN) {
+        c->type = UMPLG_STDD_BOOL;
+        c->num.b = lua_toboolean(L, idx);
+
+    } else {
+        lua_Number v = lua_tonumber(L, idx);
+        if (mink_lua_is_int(v)) {
+            c->type = UMPLG_STDD_INT;
+            c->num.i = (int64_t)v;
+        } else {
+            c->type = UMPLG_STDD_DBL;
+            c->num.d = v;
+        }
+    }
+    return 0;
+}
+
+// add lua table as row (string keys are column
+// names, other values are unnamed columns)
+static int
+mink_lua_row_add(lua_State *L, int idx, umplg_data_std_t *d)
+{
+    umplg_stdd_row_t *row = umplg_stdd_row_new(d, 0);
+    if (row == NULL) {
+        return 1;
+    }
+    lua_pushnil(L);
+    while (lua_next(L, idx)) {
+        // key is not converted (lua_next)
+        const char *n = (lua_type(L, -2) == LUA_TSTRING ? lua_tostring(L, -2) : "");
+        if (mink_lua_col_add(L, lua_gettop(L), d, row, n)) {
+            lua_pop(L, 2);
+            return 2;
+        }
+        lua_pop(L, 1);
+    }
+    return 0;
+}
+
+/***********************************/
+/* Lua value to standard data rows */
+/***********************************/
+// idx must be an absolute stack index
+int
+mink_lua_to_stdd(lua_State *L, int idx, umplg_data_std_t *d)
+{
+    // scalar (single column row)
+    if (!lua_istable(L, idx)) {
+        if (lua_isnoneornil(L, idx)) {
+            return 0;
+        }
+        umplg_stdd_row_t *row = umplg_stdd_row_new(d, 1);
+        return (row == NULL ? 1 : mink_lua_col_add(L, idx, d, row, ""));
+    }
+    // array of rows (t[1] is a table)
+    lua_rawgeti(L, idx, 1);
+    bool rows = lua_istable(L, -1);
+    lua_pop(L, 1);
+    if (!rows) {
+        return mink_lua_row_add(L, idx, d);
+    }
+    size_t sz = lua_objlen(L, idx);
+    for (size_t i = 1; i <= sz; i++) {
+        lua_rawgeti(L, idx, i);
+        if (lua_istable(L, -1) && mink_lua_row_add(L, lua_gettop(L), d)) {
+            lua_pop(L, 1);
+            return 2;
+        }
+        lua_pop(L, 1);
+    }
+    return 0;
+}
+
+/*************************/
+/* get_args (lazy proxy) */
+/*************************/
+// args/row proxy (userdata); std data is only
+// valid while handler is running
+typedef struct {
+    umplg_data_std_t *d;
+    // row index (args proxy = 0)
+    size_t r;
+} mink_lua_args_t;
+
+static const char *MINK_LUA_ARGS_MT = "mink.args";
+static const char *MINK_LUA_ROW_MT = "mink.args.row";
+
+static void mink_lua_push_args(lua_State *L, umplg_data_std_t *d, size_t r);
+
+// check proxy and std data validity
+static mink_lua_args_t *
+mink_lua_check_args(lua_State *L, const char *mt)
+{
+    mink_lua_args_t *a = luaL_checkudata(L, 1, mt);
+    lua_pushstring(L, "mink_stdd");
+    lua_gettable(L, LUA_REGISTRYINDEX);
+    umplg_data_std_t *d = lua_touserdata(L, -1);
+    lua_pop(L, 1);
+    if (a->d != d) {
+        luaL_error(L, "args used outside of handler");
+    }
+    return a;
+}
+
+// find column by name (last match, same as table
+// conversion); unnamed columns are found with k = 1
+static int
+mink_lua_find_col(umplg_data_std_t *d, size_t r, const char *k, umplg_stdd_col_t *c)
+{
+    for (size_t i = umplg_stdd_row_sz(d, r); i > 0; i--) {
+        if (umplg_stdd_col_get(d, r, i - 1, c)) {
+            continue;
+        }
+        const char *n = (c->name != NULL ? c->name : "");
+        if (k != NULL ? strcmp(n, k) == 0 : n[0] == '\0') {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// args[i]
+static int
+mink_lua_args_index(lua_State *L)
+{
+    mink_lua_args_t *a = mink_lua_check_args(L, MINK_LUA_ARGS_MT);
+    lua_Number i = lua_tonumber(L, 2);
+    if (lua_type(L, 2) != LUA_TNUMBER || i < 1 || i > umplg_stdd_rows(a->d) ||
+        (lua_Number)(size_t)i != i) {
+        lua_pushnil(L);
+        return 1;
+    }
+    mink_lua_push_args(L, a->d, (size_t)i);
+    return 1;
+}
+
+// #args
+static int
+mink_lua_args_len(lua_State *L)
+{
+    mink_lua_args_t *a = mink_lua_check_args(L, MINK_LUA_ARGS_MT);
+    lua_pushnumber(L, umplg_stdd_rows(a->d));
+    return 1;
+}
+
+// pairs(args) iterator
+static int
+mink_lua_args_next(lua_State *L)
+{
+    mink_lua_args_t *a = mink_lua_check_args(L, MINK_LUA_ARGS_MT);
+    size_t i = (lua_isnoneornil(L, 2) ? 1 : (size_t)lua_tonumber(L, 2) + 1);
+    if (i > umplg_stdd_rows(a->d)) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_pushnumber(L, i);
+    mink_lua_push_args(L, a->d, i);
+    return 2;
+}
+
+// row.name, row[1]
+static int
+mink_lua_row_index(lua_State *L)
+{
+    mink_lua_args_t *a = mink_lua_check_args(L, MINK_LUA_ROW_MT);
+    const char *k = NULL;
+    if (lua_type(L, 2) == LUA_TSTRING) {
+        k = lua_tostring(L, 2);
+    } else if (lua_type(L, 2) != LUA_TNUMBER || lua_tonumber(L, 2) != 1) {
+        lua_pushnil(L);
+        return 1;
+    }
+    umplg_stdd_col_t c;
+    if (mink_lua_find_col(a->d, a->r - 1, k, &c)) {
+        lua_pushnil(L);
+        return 1;
+    }
+    mink_lua_push_col(L, &c);
+    return 1;
+}
+
+// #row (column count)
+static int
+mink_lua_row_len(lua_State *L)
+{
+    mink_lua_args_t *a = mink_lua_check_args(L, MINK_LUA_ROW_MT);
+    lua_pushnumber(L, umplg_stdd_row_sz(a->d, a->r - 1));
+    return 1;
+}
+
+// pairs(row) iterator (column position is
+// kept as upvalue, keys can repeat)
+static int
+mink_lua_row_next(lua_State *L)
+{
+    mink_lua_args_t *a = mink_lua_check_args(L, MINK_LUA_ROW_MT);
+    size_t i = (size_t)lua_tonumber(L, lua_upvalueindex(1));
+    umplg_stdd_col_t c;
+    if (umplg_stdd_col_get(a->d, a->r - 1, i, &c)) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_pushnumber(L, i + 1);
+    lua_replace(L, lua_upvalueindex(1));
+    if (c.name != NULL && c.name[0] != '\0') {
+        lua_pushstring(L, c.name);
+    } else {
+        lua_pushnumber(L, 1);
+    }
+    mink_lua_push_col(L, &c);
+    return 2;
+}
+
+static int
+mink_lua_args_pairs(lua_State *L)
+{
+    mink_lua_check_args(L, MINK_LUA_ARGS_MT);
+    lua_pushcfunction(L, &mink_lua_args_next);
+    lua_pushvalue(L, 1);
+    lua_pushnil(L);
+    return 3;
+}
+
+static int
+mink_lua_row_pairs(lua_State *L)
+{
+    mink_lua_check_args(L, MINK_LUA_ROW_MT);
+    lua_pushnumber(L, 0);
+    lua_pushcclosure(L, &mink_lua_row_next, 1);
+    lua_pushvalue(L, 1);
+    lua_pushnil(L);
+    return 3;
+}
+
+// push args (r = 0) or row (r = 1..n) proxy
+static void
+mink_lua_push_args(lua_State *L, umplg_data_std_t *d, size_t r)
+{
+    mink_lua_args_t *a = lua_newuserdata(L, sizeof(mink_lua_args_t));
+    a->d = d;
+    a->r = r;
+    const char *mt = (r == 0 ? MINK_LUA_ARGS_MT : MINK_LUA_ROW_MT);
+    // metatable (created once per lua state)
+    if (luaL_newmetatable(L, mt)) {
+        lua_pushcfunction(L, (r == 0 ? &mink_lua_args_index : &mink_lua_row_index));
+        lua_setfield(L, -2, "__index");
+        lua_pushcfunction(L, (r == 0 ? &mink_lua_args_len : &mink_lua_row_len));
+        lua_setfield(L, -2, "__len");
+        lua_pushcfunction(L, (r == 0 ? &mink_lua_args_pairs : &mink_lua_row_pairs));
+        lua_setfield(L, -2, "__pairs");
+    }
+    lua_setmetatable(L, -2);
+}
+
+/************************/
+/* get_args (lazy view) */
+/************************/
+int
+mink_lua_get_args_lazy(lua_State *L)
+{
+    // get std data
+    lua_pushstring(L, "mink_stdd");
+    lua_gettable(L, LUA_REGISTRYINDEX);
+    umplg_data_std_t *d = lua_touserdata(L, -1);
+
+    // lazy proxy (columns are resolved on access,
+    // userdata, not usable with next/JSON encoders)
+    mink_lua_push_args(L, d, 0);
+
+    // return proxy
+    return 1;
+}
+
+/************/
+/* get_args */
+/************/
+int
+mink_lua_get_args(lua_State *L)
+{
+    // get std data
+    lua_pushstring(L, "mink_stdd");
+    lua_gettable(L, LUA_REGISTRYINDEX);
+    umplg_data_std_t *d = lua_touserdata(L, -1);
+
+    // convert to lua table
+    mink_lua_push_stdd(L, d);
 
     // return table
     return 1;
 }
 
+/******************************/
+/* get_args (LuaJIT FFI view) */
+/******************************/
+int
+mink_lua_get_args_ffi(lua_State *L)
+{
+    // get std data
+    lua_pushstring(L, "mink_stdd");
+    lua_gettable(L, LUA_REGISTRYINDEX);
+    umplg_data_std_t *d = lua_touserdata(L, -1);
+
+#ifdef HAVE_LUAJIT_H
+    // zero-copy rows only, pointer is cast to
+    // cdata by FFI wrapper (mink_lua_ffi_init)
+    lua_pushstring(L, "mink_ffi");
+    lua_gettable(L, LUA_REGISTRYINDEX);
+    bool ffi = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+    if (ffi && d != NULL && (d->items == NULL || utarray_len(d->items) == 0)) {
+        lua_pushlightuserdata(L, d);
+        return 1;
+    }
+#endif
+    // table fallback (PUC Lua, hashmap rows)
+    mink_lua_push_stdd(L, d);
+    return 1;
+}
+
 /********************/
 /* cmd_call wrapper */
 /********************/
@@ -263,87 +681,73 @@ mink_lua_do_cmd_call(lua_State *L)
     }
     // table size (length)
     size_t sz = lua_objlen(L, -1);
-    // crate string array
-    char *cmd_arg[sz];
-    for (int i = 0; i<sz; i++){
-        // get t[i] table value
-        lua_pushnumber(L, i + 1);
-        lua_gettable(L, -2);
-        // check type
-        if (lua_isstring(L, -1)) {
-            cmd_arg[i] = strdup(lua_tostring(L, -1));
-
-        } else if (lua_isnumber(L, -1)) {
-            cmd_arg[i] = malloc(32);
-            snprintf(cmd_arg[i], 32, "%d", (int)lua_tonumber(L, -1));
-
-        } else if (lua_isboolean(L, -1)) {
-            cmd_arg[i] = malloc(2);
-            snprintf(cmd_arg[i], 2, "%d", lua_toboolean(L, -1));
-
-        } else {
-            cmd_arg[i] = strdup("");
-        }
-        lua_pop(L, 1);
+    if (sz < 1) {
+        return 0;
     }
-
     // get pm
     lua_pushstring(L, "mink_pm");
     lua_gettable(L, LUA_REGISTRYINDEX);
     umplg_mngr_t *pm = lua_touserdata(L, -1);
+    lua_pop(L, 1);
 
-    // output buffer
-    umplg_data_std_t d = { .items = NULL };
-    umplg_stdd_init(&d);
-    // call method
-    int res = mink_lua_cmd_call(pm, sz, (const char **)cmd_arg, &d);
-    // free tmp string array
-    for (int i = 0; i < sz; i++) {
-        free(cmd_arg[i]);
+    // command name (t[1])
+    lua_pushnumber(L, 1);
+    lua_gettable(L, -2);
+    if (lua_type(L, -1) != LUA_TSTRING) {
+        lua_pop(L, 1);
+        return 0;
     }
-    // if successful, copy C data to lua table
-    if (res == 0){
-        // result
-        lua_newtable(L);
-        // cmd data size
-        sz = mink_lua_cmd_data_sz(&d);
-        // loop result data (rows)
-        for (int i = 0; i < sz; i++) {
-            // add row to table
-            lua_pushnumber(L, i + 1);
-            // crate table row
-            lua_newtable(L);
-            // get column count
-            size_t sz_c = mink_lua_cmd_data_row_sz(i, &d);
-            // loop columns
-            for (int j = 0; j < sz_c; j++) {
-                // get column key/value
-                mink_cdata_column_t c = mink_lua_cmd_data_get_column(i, j, &d);
-                // add column to lua table
-                if (c.value != NULL) {
-                    int k = 1;
-                    // update key, if not null
-                    if (c.key != NULL && strlen(c.key) > 0) {
-                        // k = ffi.string(c.key)
-                        lua_pushstring(L, c.key);
-
-                    } else {
-                        // k = 1
-                        lua_pushnumber(L, k);
-                    }
-
-                    // add value and add table column
-                    lua_pushstring(L, c.value);
-                    lua_settable(L, -3);
-                }
+    int cmd_id = umplg_get_cmd_id(pm, lua_tostring(L, -1));
+    lua_pop(L, 1);
+
+    // in/out data (stack arena)
+    char arena[512];
+    umplg_data_std_t d = { .items = NULL };
+    umplg_stdd_init_buf(&d, arena, sizeof(arena));
+
+    // cmd arguments (typed, zero-copy rows); lua strings
+    // are referenced directly (arg table stays on the stack)
+    for (size_t i = 2; i <= sz; i++) {
+        // get t[i] table value
+        lua_pushnumber(L, i);
+        lua_gettable(L, -2);
+        umplg_stdd_row_t *row = umplg_stdd_row_new(&d, 1);
+        switch (lua_type(L, -1)) {
+        case LUA_TSTRING: {
+            size_t l = 0;
+            const char *v = lua_tolstring(L, -1, &l);
+            umplg_stdd_col_add(&d, row, "", v, l);
+            break;
+        }
+        case LUA_TNUMBER: {
+            lua_Number n = lua_tonumber(L, -1);
+            if (mink_lua_is_int(n)) {
+                umplg_stdd_col_add_int(&d, row, "", (int64_t)n);
+            } else {
+                umplg_stdd_col_add_dbl(&d, row, "", n);
             }
-            // add table row
-            lua_settable(L, -3);
+            break;
+        }
+        case LUA_TBOOLEAN:
+            umplg_stdd_col_add_bool(&d, row, "", lua_toboolean(L, -1));
+            break;
+        default:
+            umplg_stdd_col_add(&d, row, "", "", 0);
+            break;
         }
+        lua_pop(L, 1);
+    }
+
+    // plugin input data
+    umplg_idata_t idata = { UMPLG_DT_STANDARD, &d };
+    // call method
+    int res = umplg_run(pm, cmd_id, idata.type, &idata, true);
+    // if successful, copy C data to lua table
+    if (res == 0) {
+        mink_lua_push_stdd(L, &d);
         // cleanup
         umplg_stdd_free(&d);
         return 1;
-
     }
     umplg_stdd_free(&d);
     return 0;
@@ -358,14 +762,15 @@ mink_lua_do_signal(lua_State *L)
 
     // signal data/signal name
     const char *d = NULL;
+    size_t d_sz = 0;
     const char *s = NULL;
 
-    // signal name and data
+    // signal name and data (binary safe)
     if (lua_gettop(L) >= 2) {
         if (!lua_isstring(L, -1) || !lua_isstring(L, -2)) {
             return 0;
         }
-        d = lua_tostring(L, -1);
+        d = lua_tolstring(L, -1, &d_sz);
         s = lua_tostring(L, -2);
 
     // signal name only
@@ -382,15 +787,41 @@ mink_lua_do_signal(lua_State *L)
     umplg_mngr_t *pm = lua_touserdata(L, -1);
     lua_pop(L, 1);
 
+    // signal input (zero-copy, stack arena)
+    char arena[512];
+    umplg_data_std_t e_d = { .items = NULL };
+    umplg_stdd_init_buf(&e_d, arena, sizeof(arena));
+    umplg_stdd_row_t *row = umplg_stdd_row_new(&e_d, 1);
+    umplg_stdd_col_add(&e_d, row, "", d, d_sz);
+    // signal output (structured)
+    char arena_o[512];
+    umplg_data_std_t o_d = { .items = NULL };
+    umplg_stdd_init_buf(&o_d, arena_o, sizeof(arena_o));
+
     // signal
-    char *s_res = mink_lua_signal(s, d, pm);
-    if (s_res != NULL) {
-        lua_pushstring(L, s_res);
-        free(s_res);
+    umplg_stdd_col_t c;
+    if (umplg_proc_signal_stdd(pm, s, &e_d, &o_d) != 0 || umplg_stdd_rows(&o_d) == 0) {
+        lua_pushstring(L, "");
+
+        // single value (string output, typed
+        // values are converted to strings)
+    } else if (umplg_stdd_rows(&o_d) == 1 && umplg_stdd_row_sz(&o_d, 0) == 1 &&
+               umplg_stdd_col_get(&o_d, 0, 0, &c) == 0 &&
+               (c.name == NULL || c.name[0] == '\0')) {
+        char nb[32];
+        const char *v = umplg_stdd_col_str(&c, nb, sizeof(nb));
+        if (v == NULL) {
+            lua_pushstring(L, "");
+        } else {
+            lua_pushlstring(L, v, (v == nb ? strlen(nb) : c.sz));
+        }
 
+        // rows
     } else {
-        lua_pushstring(L, strdup(""));
+        mink_lua_push_stdd(L, &o_d);
     }
+    umplg_stdd_free(&o_d);
+    umplg_stdd_free(&e_d);
 
     return 1;
 }
@@ -11,9 +11,16 @@
 #include <umink_pkg_config.h>
 #include <umink_plugin.h>
 #include <umatomic.h>
+#include <umtwheel.h>
 #include <stdio.h>
+#include <stddef.h>
+#include <inttypes.h>
 #include <pthread.h>
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <umdaemon.h>
 #include <linkhash.h>
 #include <uthash.h>
@@ -24,6 +31,9 @@
 #include <lualib.h>
 #include <lauxlib.h>
 #include <utarray.h>
+#ifdef HAVE_LUAJIT_H
+#include <luajit.h>
+#endif
 
 /*************/
 /* Plugin ID */
@@ -34,9 +44,15 @@ static const char *PLG_ID = "plg_sysagent_lua.so";
 /* list of command implemented by this plugin */
 /**********************************************/
 int COMMANDS[] = { CMD_LUA_CALL,
+                   CMD_LUA_STATS,
                    // end of list marker
                    -1 };
 
+/*******************/
+/* plugin features */
+/*******************/
+uint32_t FEATURES = UMPLG_FEAT_STDD_ZC;
+
 /****************/
 /* LUA ENV data */
 /****************/
@@ -60,24 +76,186 @@ struct lua_env_d {
     uint8_t active;
     // path to lua script
     char *path;
+    // number of pre-loaded Lua
+    // states per event handler
+    uint8_t workers;
     // plugin manager pointer
     umplg_mngr_t *pm;
-    // thread
+    // max random delay added to each
+    // execution (ms, 0 = disabled)
+    uint64_t jitter;
+    unsigned int seed;
+    // scheduler timer
+    umtw_timer_t tmr;
+    // next nominal execution (fixed rate)
+    uint64_t due;
+    // missed executions (total/reported)
+    uint64_t missed;
+    uint64_t missed_rep;
+    // queued or running on worker
+    bool busy;
+    // one-time env thread (interval = 0)
+    pthread_t th;
+    bool th_started;
+    // next env in ready queue
+    struct lua_env_d *next_rdy;
+    // lua state (created on first execution)
+    lua_State *L;
+    // memory limit per lua state
+    // (bytes, 0 = unlimited)
+    size_t mem_limit;
+    // hashable
+    UT_hash_handle hh;
+};
+
+// allocator size classes (16 - 512 bytes) and
+// slab size (small blocks are carved from slabs)
+#define LUA_MEM_CLS      6
+#define LUA_MEM_CLS_MAX  (16 << (LUA_MEM_CLS - 1))
+#define LUA_MEM_SLAB_SZ  8192
+
+/*********************/
+/* LUA ENV scheduler */
+/*********************/
+struct lua_env_sched {
+    // timer wheel (ms since start)
+    umtw_t *tw;
+    // start time (monotonic, ms)
+    uint64_t ts;
+    // ready queue
+    struct lua_env_d *rdy_h;
+    struct lua_env_d *rdy_t;
+    // running flag
+    bool running;
+    // scheduler thread
     pthread_t th;
+    // worker threads
+    pthread_t *wrks;
+    int wrks_n;
+    // lock (wheel and ready queue)
+    pthread_mutex_t mtx;
+    // scheduler/worker wakeup
+    pthread_cond_t sched_cnd;
+    pthread_cond_t wrk_cnd;
+};
+
+/**********************/
+/* LUA compiled chunk */
+/**********************/
+struct lua_chunk {
+    // script path (key)
+    char *path;
+    // chunk name ("@path")
+    char *name;
+    // bytecode
+    char *bc;
+    size_t sz;
     // hashable
     UT_hash_handle hh;
 };
 
+/********************************/
+/* LUA state memory (per state) */
+/********************************/
+struct lua_mem_slab {
+    struct lua_mem_slab *next;
+    // block alignment
+    void *pad;
+};
+
+struct lua_mem {
+    // owner (env name, signal id or NULL
+    // for periodic env state)
+    const char *env;
+    const char *sig;
+    // bytes in use/peak/limit (0 = unlimited)
+    size_t used;
+    size_t peak;
+    size_t limit;
+    // slab bytes (pool) and large block bytes,
+    // limit is charged on both
+    size_t pool;
+    size_t large;
+    // number of allocations/denied allocations
+    uint64_t allocs;
+    uint64_t denied;
+    // size class free lists
+    void *fl[LUA_MEM_CLS];
+    // slabs
+    struct lua_mem_slab *slabs;
+    // hashable (key = lua state)
+    lua_State *L;
+    UT_hash_handle hh;
+};
+
 /*******************/
 /* LUA ENV Manager */
 /*******************/
 struct lua_env_mngr {
     // lua envs
     struct lua_env_d *envs;
+    // compiled chunks (shared by all
+    // states running the same script)
+    struct lua_chunk *chunks;
+    pthread_mutex_t chunks_mtx;
+    // bytecode cache dir (NULL = disabled)
+    char *bc_dir;
+    // lua state allocators (stats)
+    struct lua_mem *mems;
+    pthread_mutex_t mems_mtx;
+    // env scheduler
+    struct lua_env_sched sched;
     // lock
     pthread_mutex_t mtx;
 };
 
+/*****************************/
+/* LUA signal handler worker */
+/*****************************/
+struct lua_sh_worker {
+    // pre-loaded lua state
+    lua_State *L;
+    // thread currently using this state
+    // (published before running is set)
+    pthread_t owner;
+    // running flag (recursion detection,
+    // read by other threads, atomic)
+    uint8_t running;
+    // stack top before handler results
+    int top;
+};
+
+/*********************************/
+/* LUA signal handler state pool */
+/*********************************/
+struct lua_sh_pool {
+    // pool size
+    uint8_t sz;
+    // bitmask of available states
+    uint64_t free;
+    // number of threads waiting
+    // for a state to be released
+    uint32_t waiting;
+    // lua states
+    struct lua_sh_worker *workers;
+    // slow path (all states in use)
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+};
+
+// max number of Lua states per signal handler
+#define LUA_SH_POOL_MAX 64
+// number of env worker threads (default/max)
+#define LUA_ENV_WORKERS_DEF 4
+#define LUA_ENV_WORKERS_MAX 64
+// bytecode is specific to VM flavour/version
+// and pointer size (part of cache key)
+#ifdef LUAJIT_VERSION
+#define LUA_BC_VM LUAJIT_VERSION
+#else
+#define LUA_BC_VM LUA_RELEASE
+#endif
+
 #if !defined LUA_VERSION_NUM || LUA_VERSION_NUM == 501
 
 #define luaL_newlibtable(L,l)	\
@@ -109,10 +287,19 @@ luaL_setfuncs(lua_State *L, const luaL_Reg *l, int nup)
 /*******************/
 int mink_lua_do_signal(lua_State *L);
 int mink_lua_get_args(lua_State *L);
+int mink_lua_get_args_ffi(lua_State *L);
+int mink_lua_get_args_lazy(lua_State *L);
 int mink_lua_do_cmd_call(lua_State *L);
+int mink_lua_to_stdd(lua_State *L, int idx, umplg_data_std_t *d);
+#ifdef HAVE_LUAJIT_H
+int mink_lua_ffi_init(lua_State *L);
+#endif
 
 // registered lua module methods
 static const struct luaL_Reg mink_lualib[] = { { "get_args", &mink_lua_get_args },
+                                               { "get_args_ffi", &mink_lua_get_args_ffi },
+                                               { "get_args_table", &mink_lua_get_args },
+                                               { "get_args_lazy", &mink_lua_get_args_lazy },
                                                { "signal", &mink_lua_do_signal },
                                                { "cmd_call", &mink_lua_do_cmd_call },
                                                { NULL, NULL } };
@@ -128,16 +315,32 @@ struct lua_env_mngr *lenv_mngr = NULL;
 struct lua_env_mngr *
 lenvm_new()
 {
-    struct lua_env_mngr *lem = malloc(sizeof(struct lua_env_mngr));
+    struct lua_env_mngr *lem = calloc(1, sizeof(struct lua_env_mngr));
     lem->envs = NULL;
+    lem->sched.wrks_n = LUA_ENV_WORKERS_DEF;
     pthread_mutex_init(&lem->mtx, NULL);
+    pthread_mutex_init(&lem->chunks_mtx, NULL);
+    pthread_mutex_init(&lem->mems_mtx, NULL);
     return lem;
 }
 
 void
 lenvm_free(struct lua_env_mngr *m)
 {
+    struct lua_chunk *c = NULL;
+    struct lua_chunk *tmp = NULL;
+    HASH_ITER(hh, m->chunks, c, tmp)
+    {
+        HASH_DEL(m->chunks, c);
+        free(c->path);
+        free(c->name);
+        free(c->bc);
+        free(c);
+    }
+    pthread_mutex_destroy(&m->chunks_mtx);
+    pthread_mutex_destroy(&m->mems_mtx);
     pthread_mutex_destroy(&m->mtx);
+    free(m->bc_dir);
     free(m);
 }
 
@@ -222,16 +425,483 @@ lenvm_process_envs(struct lua_env_mngr *lem, void (*f)(struct lua_env_d *env))
     pthread_mutex_unlock(&lem->mtx);
 }
 
+/**********************/
+/* LUA bytecode cache */
+/**********************/
+// lua_dump writer (growing buffer)
+struct lua_bc_buf {
+    char *p;
+    size_t sz;
+    size_t cap;
+};
+
+static int
+lua_bc_writer(lua_State *L, const void *p, size_t sz, void *ud)
+{
+    struct lua_bc_buf *b = ud;
+    if (b->sz + sz > b->cap) {
+        size_t cap = (b->cap > 0 ? b->cap * 2 : 4096);
+        while (cap < b->sz + sz) {
+            cap *= 2;
+        }
+        char *np = realloc(b->p, cap);
+        if (np == NULL) {
+            return 1;
+        }
+        b->p = np;
+        b->cap = cap;
+    }
+    memcpy(b->p + b->sz, p, sz);
+    b->sz += sz;
+    return 0;
+}
+
+// cache file path (one file per script, stale
+// contents are detected by key in file header)
+static char *
+lua_bc_path(const char *dir, const char *path)
+{
+    unsigned int h = 0;
+    size_t sz = snprintf(NULL, 0, "%s|%s", path, LUA_BC_VM);
+    char k[sz + 1];
+    snprintf(k, sz + 1, "%s|%s", path, LUA_BC_VM);
+    HASH_FNV(k, sz, h);
+    sz = snprintf(NULL, 0, "%s/%08x.luac", dir, h);
+    char *fp = malloc(sz + 1);
+    if (fp != NULL) {
+        snprintf(fp, sz + 1, "%s/%08x.luac", dir, h);
+    }
+    return fp;
+}
+
+// cache dir and files must be owned by daemon user, not
+// writable by group/others and not symlinks (bytecode
+// is loaded without verification)
+static bool
+lua_bc_trusted(const struct stat *st, mode_t type)
+{
+    return (st->st_mode & S_IFMT) == type && st->st_uid == geteuid() &&
+           (st->st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+// read cached bytecode ("key\0" + bytecode); bad
+// is set if cache file is not trusted
+static char *
+lua_bc_read(const char *dir, const char *path, const char *key, size_t *sz, bool *bad)
+{
+    char *fp = lua_bc_path(dir, path);
+    if (fp == NULL) {
+        return NULL;
+    }
+    int fd = open(fp, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    free(fp);
+    if (fd < 0) {
+        *bad = (errno == ELOOP);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) || !lua_bc_trusted(&st, S_IFREG)) {
+        *bad = true;
+        close(fd);
+        return NULL;
+    }
+    FILE *f = fdopen(fd, "rb");
+    if (f == NULL) {
+        close(fd);
+        return NULL;
+    }
+    size_t kl = strlen(key) + 1;
+    if ((size_t)st.st_size <= kl) {
+        fclose(f);
+        return NULL;
+    }
+    char *buf = malloc(st.st_size);
+    if (buf == NULL || fread(buf, st.st_size, 1, f) != 1 || memcmp(buf, key, kl) != 0) {
+        free(buf);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+    // strip header
+    *sz = st.st_size - kl;
+    memmove(buf, buf + kl, *sz);
+    return buf;
+}
+
+// write cached bytecode (atomic replace)
+static int
+lua_bc_write(const char *dir, const char *path, const char *key, const char *bc, size_t sz)
+{
+    char *fp = lua_bc_path(dir, path);
+    if (fp == NULL) {
+        return 1;
+    }
+    size_t tl = strlen(dir) + 16;
+    char tmp[tl];
+    snprintf(tmp, tl, "%s/.luacXXXXXX", dir);
+    int fd = mkstemp(tmp);
+    if (fd < 0) {
+        free(fp);
+        return 2;
+    }
+    FILE *f = fdopen(fd, "wb");
+    if (f == NULL) {
+        close(fd);
+        unlink(tmp);
+        free(fp);
+        return 3;
+    }
+    int r = 0;
+    if (fwrite(key, strlen(key) + 1, 1, f) != 1 || fwrite(bc, sz, 1, f) != 1) {
+        r = 4;
+    }
+    if (fclose(f) || r != 0 || rename(tmp, fp)) {
+        unlink(tmp);
+        r = 5;
+    }
+    free(fp);
+    return r;
+}
+
+// compile script and add to chunk cache (chunks
+// lock held); compiled chunk or error message is
+// left on stack
+static int
+lua_chunk_compile(struct lua_env_mngr *lem, lua_State *L, const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) || st.st_size <= 0) {
+        lua_pushfstring(L, "cannot open Lua script (%s)", path);
+        return 1;
+    }
+    // cache key (script identity and VM)
+    size_t sz = snprintf(NULL,
+                         0,
+                         "%s|%lld.%09ld|%lld|%s|%zu",
+                         path,
+                         (long long)st.st_mtim.tv_sec,
+                         st.st_mtim.tv_nsec,
+                         (long long)st.st_size,
+                         LUA_BC_VM,
+                         sizeof(void *));
+    char key[sz + 1];
+    snprintf(key,
+             sz + 1,
+             "%s|%lld.%09ld|%lld|%s|%zu",
+             path,
+             (long long)st.st_mtim.tv_sec,
+             st.st_mtim.tv_nsec,
+             (long long)st.st_size,
+             LUA_BC_VM,
+             sizeof(void *));
+    // chunk name
+    sz = strlen(path) + 2;
+    char name[sz];
+    snprintf(name, sz, "@%s", path);
+
+    struct lua_bc_buf b = { NULL, 0, 0 };
+    // try bytecode cache (rejected bytecode
+    // is recompiled)
+    if (lem->bc_dir != NULL) {
+        bool bad = false;
+        b.p = lua_bc_read(lem->bc_dir, path, key, &b.sz, &bad);
+        if (bad) {
+            umd_log(UMD,
+                    UMD_LLT_WARNING,
+                    "plg_lua: [untrusted Lua bytecode cache file, cache disabled (%s)]",
+                    path);
+            free(lem->bc_dir);
+            lem->bc_dir = NULL;
+        }
+        if (b.p != NULL && luaL_loadbuffer(L, b.p, b.sz, name)) {
+            lua_pop(L, 1);
+            free(b.p);
+            b.p = NULL;
+        }
+    }
+    // compile source
+    if (b.p == NULL) {
+        FILE *f = fopen(path, "rb");
+        if (f == NULL) {
+            lua_pushfstring(L, "cannot open Lua script (%s)", path);
+            return 2;
+        }
+        char *src = malloc(st.st_size);
+        if (src == NULL || fread(src, st.st_size, 1, f) != 1) {
+            free(src);
+            fclose(f);
+            lua_pushfstring(L, "cannot read Lua script (%s)", path);
+            return 3;
+        }
+        fclose(f);
+        int r = luaL_loadbuffer(L, src, st.st_size, name);
+        free(src);
+        if (r) {
+            return 4;
+        }
+        // dump bytecode (keep debug info)
+#if LUA_VERSION_NUM >= 503
+        r = lua_dump(L, &lua_bc_writer, &b, 0);
+#else
+        r = lua_dump(L, &lua_bc_writer, &b);
+#endif
+        // chunk is loaded, run without cache
+        if (r) {
+            free(b.p);
+            return 0;
+        }
+        if (lem->bc_dir != NULL && lua_bc_write(lem->bc_dir, path, key, b.p, b.sz)) {
+            umd_log(UMD,
+                    UMD_LLT_WARNING,
+                    "plg_lua: [cannot write Lua bytecode cache (%s)]",
+                    path);
+        }
+    }
+    // add to chunk cache
+    struct lua_chunk *c = calloc(1, sizeof(struct lua_chunk));
+    if (c == NULL) {
+        free(b.p);
+        return 0;
+    }
+    c->path = strdup(path);
+    c->name = strdup(name);
+    c->bc = b.p;
+    c->sz = b.sz;
+    HASH_ADD_KEYPTR(hh, lem->chunks, c->path, strlen(c->path), c);
+    return 0;
+}
+
+// load script chunk (compiled only once per
+// process, bytecode loaded afterwards)
+static int
+lua_chunk_load(struct lua_env_mngr *lem, lua_State *L, const char *path)
+{
+    pthread_mutex_lock(&lem->chunks_mtx);
+    struct lua_chunk *c = NULL;
+    HASH_FIND_STR(lem->chunks, path, c);
+    // first load
+    if (c == NULL) {
+        int r = lua_chunk_compile(lem, L, path);
+        pthread_mutex_unlock(&lem->chunks_mtx);
+        return r;
+    }
+    pthread_mutex_unlock(&lem->chunks_mtx);
+    // chunks are immutable until plugin terminates
+    return luaL_loadbuffer(L, c->bc, c->sz, c->name);
+}
+
+/************************/
+/* LUA memory allocator */
+/************************/
+static size_t
+lua_mem_cls(size_t sz)
+{
+    // 16, 32, 64 ... LUA_MEM_CLS_MAX
+    return (sz <= 16 ? 0 : 64 - __builtin_clzll(sz - 1) - 4);
+}
+
+// check if sz more bytes would exceed the limit
+static bool
+lua_mem_over(struct lua_mem *m, size_t sz)
+{
+    if (m->limit > 0 && m->pool + m->large + sz > m->limit) {
+        m->denied++;
+        return true;
+    }
+    return false;
+}
+
+// get block from size class free list (new
+// slab is carved if free list is empty)
+static void *
+lua_mem_get(struct lua_mem *m, size_t c, bool lim)
+{
+    void *p = m->fl[c];
+    if (p != NULL) {
+        m->fl[c] = *(void **)p;
+        return p;
+    }
+    if (lim && lua_mem_over(m, LUA_MEM_SLAB_SZ)) {
+        return NULL;
+    }
+    struct lua_mem_slab *s = malloc(LUA_MEM_SLAB_SZ);
+    if (s == NULL) {
+        return NULL;
+    }
+    s->next = m->slabs;
+    m->slabs = s;
+    m->pool += LUA_MEM_SLAB_SZ;
+    // first block is returned, others
+    // are added to free list
+    size_t bsz = (size_t)16 << c;
+    size_t n = (LUA_MEM_SLAB_SZ - sizeof(struct lua_mem_slab)) / bsz;
+    char *b = (char *)s + sizeof(struct lua_mem_slab);
+    for (size_t i = n - 1; i > 0; i--) {
+        *(void **)(b + i * bsz) = m->fl[c];
+        m->fl[c] = b + i * bsz;
+    }
+    return b;
+}
+
+static void
+lua_mem_put(struct lua_mem *m, void *p, size_t sz)
+{
+    if (sz > LUA_MEM_CLS_MAX) {
+        free(p);
+        m->large -= sz;
+        return;
+    }
+    size_t c = lua_mem_cls(sz);
+    *(void **)p = m->fl[c];
+    m->fl[c] = p;
+}
+
+// lua_Alloc (state is used by one thread at a time,
+// small blocks are served from size class pool)
+static void *
+lua_mem_alloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+    struct lua_mem *m = ud;
+    // osize is object type for new blocks (5.2+)
+    if (ptr == NULL) {
+        osize = 0;
+    }
+    // free
+    if (nsize == 0) {
+        if (ptr != NULL) {
+            lua_mem_put(m, ptr, osize);
+            m->used -= osize;
+        }
+        return NULL;
+    }
+    // hard limit is charged on slabs and large
+    // blocks (shrinking must not fail)
+    bool lim = (nsize > osize);
+    void *np = NULL;
+    // large block
+    if (osize > LUA_MEM_CLS_MAX && nsize > LUA_MEM_CLS_MAX) {
+        if (lim && lua_mem_over(m, nsize - osize)) {
+            return NULL;
+        }
+        np = realloc(ptr, nsize);
+        if (np != NULL) {
+            m->large = m->large - osize + nsize;
+        }
+
+        // same size class
+    } else if (ptr != NULL && osize <= LUA_MEM_CLS_MAX && nsize <= LUA_MEM_CLS_MAX &&
+               lua_mem_cls(osize) == lua_mem_cls(nsize)) {
+        np = ptr;
+
+        // new block or size class change
+    } else {
+        if (nsize <= LUA_MEM_CLS_MAX) {
+            np = lua_mem_get(m, lua_mem_cls(nsize), lim);
+        } else if (!lim || !lua_mem_over(m, nsize)) {
+            np = malloc(nsize);
+            if (np != NULL) {
+                m->large += nsize;
+            }
+        }
+        if (np != NULL && ptr != NULL) {
+            memcpy(np, ptr, (osize < nsize ? osize : nsize));
+            lua_mem_put(m, ptr, osize);
+        }
+    }
+    if (np == NULL) {
+        return NULL;
+    }
+    // stats
+    if (ptr == NULL) {
+        m->allocs++;
+    }
+    m->used = m->used - osize + nsize;
+    if (m->used > m->peak) {
+        m->peak = m->used;
+    }
+    return np;
+}
+
+// create lua state with pool allocator (falls back
+// to default allocator if not supported by VM)
+static lua_State *
+lua_mem_new_state(struct lua_env_mngr *lem, struct lua_env_d *env, const char *sig)
+{
+    struct lua_mem *m = calloc(1, sizeof(struct lua_mem));
+    if (m == NULL) {
+        return NULL;
+    }
+    m->env = env->name;
+    m->sig = sig;
+    lua_State *L = lua_newstate(&lua_mem_alloc, m);
+    // custom allocators are not supported on
+    // some LuaJIT targets (non-GC64)
+    if (L == NULL) {
+        free(m);
+        return luaL_newstate();
+    }
+    m->L = L;
+    pthread_mutex_lock(&lem->mems_mtx);
+    HASH_ADD_PTR(lem->mems, L, m);
+    pthread_mutex_unlock(&lem->mems_mtx);
+    return L;
+}
+
+// free allocator (lua state closed, all
+// blocks were released to pool)
+static void
+lua_mem_free(struct lua_env_mngr *lem, struct lua_mem *m)
+{
+    pthread_mutex_lock(&lem->mems_mtx);
+    HASH_DEL(lem->mems, m);
+    pthread_mutex_unlock(&lem->mems_mtx);
+    while (m->slabs != NULL) {
+        struct lua_mem_slab *s = m->slabs;
+        m->slabs = s->next;
+        free(s);
+    }
+    free(m);
+}
+
+// set state memory limit (0 = unlimited); -1 is
+// returned if limit cannot be enforced (default
+// allocator)
+static int
+lua_mem_limit(lua_State *L, size_t limit)
+{
+    void *ud = NULL;
+    if (lua_getallocf(L, &ud) != &lua_mem_alloc) {
+        return (limit > 0 ? -1 : 0);
+    }
+    struct lua_mem *m = ud;
+    if (limit > 0 && m->pool + m->large > limit) {
+        return 1;
+    }
+    m->limit = limit;
+    return 0;
+}
+
+// close lua state and free its allocator
+static void
+lua_env_close_state(lua_State *L)
+{
+    void *ud = NULL;
+    lua_Alloc f = lua_getallocf(L, &ud);
+    lua_close(L);
+    if (f == &lua_mem_alloc) {
+        lua_mem_free(lenv_mngr, ud);
+    }
+}
+
 /*******************/
 /* LUA Environment */
 /*******************/
-static void *
-th_lua_env(void *arg)
+static lua_State *
+lua_env_new_state(struct lua_env_d *env, const char *sig)
 {
-    // lua envd
-    struct lua_env_d *env = arg;
-    // lua state
-    lua_State *L = luaL_newstate();
+    // lua state (signal handler or periodic
+    // env, sig = NULL)
+    lua_State *L = lua_mem_new_state(lenv_mngr, env, sig);
     if (!L) {
         umd_log(UMD, UMD_LLT_ERROR, "plg_lua: [cannot create Lua environment]");
         return NULL;
@@ -242,6 +912,21 @@ th_lua_env(void *arg)
     // init umink lua module
     luaL_newlib(L, mink_lualib);
     lua_setglobal(L, "M");
+#ifdef HAVE_LUAJIT_H
+    // FFI view of std data (M.get_args_ffi); table
+    // view is used if FFI is not available
+    if (mink_lua_ffi_init(L)) {
+        static uint8_t ffi_err = 0;
+        if (UM_ATOMIC_COMP_SWAP(&ffi_err, 0, 1) == 0) {
+            umd_log(UMD,
+                    UMD_LLT_WARNING,
+                    "plg_lua: [LuaJIT FFI not available, using tables (%s)]:%s",
+                    env->name,
+                    lua_tostring(L, -1));
+        }
+        lua_pop(L, 1);
+    }
+#endif
 
     // table key = address of pm pointer
     // =================================
@@ -251,81 +936,408 @@ th_lua_env(void *arg)
     lua_settable(L, LUA_REGISTRYINDEX);
 
     // load lua script
-    FILE *f = fopen(env->path, "r");
-    if (f == NULL) {
+    if (lua_chunk_load(lenv_mngr, L, env->path)) {
+        umd_log(UMD,
+                UMD_LLT_ERROR,
+                "plg_lua: [cannot load Lua environment (%s)]:%s",
+                env->name,
+                lua_tostring(L, -1));
+        lua_env_close_state(L);
         return NULL;
     }
-    if (fseek(f, 0, SEEK_END) < 0) {
-        fclose(f);
+
+    // memory limit (state init is not limited)
+    int r = lua_mem_limit(L, env->mem_limit);
+    if (r < 0) {
+        static uint8_t lim_err = 0;
+        if (UM_ATOMIC_COMP_SWAP(&lim_err, 0, 1) == 0) {
+            umd_log(UMD,
+                    UMD_LLT_WARNING,
+                    "plg_lua: [memory limit not enforced for '%s' Lua environment "
+                    "(custom allocator not supported)]",
+                    env->name);
+        }
+    } else if (r > 0) {
+        umd_log(UMD,
+                UMD_LLT_ERROR,
+                "plg_lua: [memory limit too low for '%s' Lua environment]",
+                env->name);
+        lua_env_close_state(L);
         return NULL;
     }
-    int32_t fsz = ftell(f);
-    if (fsz <= 0) {
-        fclose(f);
-        return NULL;
+
+    // precompiled chunk left on stack
+    return L;
+}
+
+// run env once (worker thread, env is not
+// running on any other worker)
+static void
+lua_env_run(struct lua_env_d *env)
+{
+    // lua state (precompiled chunk left on stack)
+    if (env->L == NULL) {
+        env->L = lua_env_new_state(env, NULL);
+        if (env->L == NULL) {
+            return;
+        }
+        umd_log(UMD, UMD_LLT_INFO, "plg_lua: [starting '%s' Lua environment]", env->name);
+    }
+    lua_State *L = env->L;
+    // copy precompiled lua chunk (pcall removes it)
+    lua_pushvalue(L, -1);
+    // run lua script
+    if (lua_pcall(L, 0, 1, 0)) {
+        umd_log(UMD, UMD_LLT_ERROR, "plg_lua: [%s]:%s", env->name, lua_tostring(L, -1));
+    }
+    // pop result or error message
+    lua_pop(L, 1);
+    // one-time only, remove lua state
+    if (env->interval == 0) {
+        lua_env_close_state(L);
+        env->L = NULL;
+        umd_log(UMD, UMD_LLT_INFO, "plg_lua: [stopping '%s' Lua environment]", env->name);
     }
+}
 
-    char lua_s[fsz + 1];
-    memset(lua_s, 0, fsz + 1);
-    rewind(f);
-    fread(lua_s, fsz, 1, f);
-    fclose(f);
+/**********************/
+/* LUA ENV scheduling */
+/**********************/
+static uint64_t
+lua_env_sched_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
 
-    // load lua script
-    if (luaL_loadstring(L, lua_s)) {
-        umd_log(UMD,
-                UMD_LLT_ERROR,
-                "plg_lua: [cannot load Lua environment (%s)]:%s",
-                env->name,
-                lua_tostring(L, -1));
-        lua_close(L);
-        return NULL;
+// random execution delay
+static uint64_t
+lua_env_jitter(struct lua_env_d *env)
+{
+    if (env->jitter == 0) {
+        return 0;
+    }
+    return (uint64_t)rand_r(&env->seed) % (env->jitter + 1);
+}
+
+// env timer expired (scheduler thread, lock held)
+static void
+lua_env_sched_expired(umtw_timer_t *t, void *arg)
+{
+    struct lua_env_sched *s = arg;
+    struct lua_env_d *env = (struct lua_env_d *)((char *)t - offsetof(struct lua_env_d, tmr));
+    // stopped
+    if (!UM_ATOMIC_GET(&env->active) || umd_is_terminating()) {
+        return;
     }
+    uint64_t missed = 0;
+    // previous execution still running, skip
+    if (env->busy) {
+        missed++;
+
+        // queue for execution
+    } else {
+        env->busy = true;
+        env->next_rdy = NULL;
+        if (s->rdy_t != NULL) {
+            s->rdy_t->next_rdy = env;
+        } else {
+            s->rdy_h = env;
+        }
+        s->rdy_t = env;
+    }
+    // next execution (fixed rate, skip periods
+    // that have already passed)
+    uint64_t now = s->tw->now;
+    env->due += env->interval;
+    if (env->due <= now) {
+        uint64_t k = (now - env->due) / env->interval + 1;
+        env->due += k * env->interval;
+        missed += k;
+    }
+    env->missed += missed;
+    umtw_add(s->tw, &env->tmr, env->due + lua_env_jitter(env));
+}
 
-    // sleep interval
-    uint64_t sec = env->interval / 1000;
-    uint64_t nsec = (uint64_t)env->interval % 1000 * 1000000;
-    struct timespec st = { sec, nsec };
+static void *
+th_lua_sched(void *arg)
+{
+    struct lua_env_sched *s = arg;
+    pthread_mutex_lock(&s->mtx);
+    while (s->running) {
+        // fire expired timers
+        if (umtw_advance(s->tw, lua_env_sched_now() - s->ts, &lua_env_sched_expired, s) >
+                0 &&
+            s->rdy_h != NULL) {
+            pthread_cond_broadcast(&s->wrk_cnd);
+        }
+        // no timers, wait for new env
+        if (s->tw->n == 0) {
+            pthread_cond_wait(&s->sched_cnd, &s->mtx);
+            continue;
+        }
+        // wait for next expiry/cascade
+        uint64_t w = s->ts + s->tw->now + umtw_next(s->tw);
+        struct timespec ts = { w / 1000, (w % 1000) * 1000000 };
+        pthread_cond_timedwait(&s->sched_cnd, &s->mtx, &ts);
+    }
+    pthread_mutex_unlock(&s->mtx);
+    return NULL;
+}
 
-    umd_log(UMD, UMD_LLT_INFO, "plg_lua: [starting '%s' Lua environment]", env->name);
-    // run
-    while (!umd_is_terminating() && UM_ATOMIC_GET(&env->active)) {
-        // copy precompiled lua chunk (pcall removes it)
-        lua_pushvalue(L, -1);
-        // run lua script
-        if (lua_pcall(L, 0, 1, 0)) {
+static void *
+th_lua_worker(void *arg)
+{
+    struct lua_env_sched *s = arg;
+    pthread_mutex_lock(&s->mtx);
+    for (;;) {
+        while (s->running && s->rdy_h == NULL) {
+            pthread_cond_wait(&s->wrk_cnd, &s->mtx);
+        }
+        if (!s->running) {
+            break;
+        }
+        // dequeue
+        struct lua_env_d *env = s->rdy_h;
+        s->rdy_h = env->next_rdy;
+        if (s->rdy_h == NULL) {
+            s->rdy_t = NULL;
+        }
+        pthread_mutex_unlock(&s->mtx);
+
+        // run
+        lua_env_run(env);
+
+        pthread_mutex_lock(&s->mtx);
+        env->busy = false;
+        // report missed executions
+        uint64_t m = env->missed - env->missed_rep;
+        env->missed_rep = env->missed;
+        if (m > 0) {
             umd_log(UMD,
-                    UMD_LLT_ERROR,
-                    "plg_lua: [%s]:%s",
+                    UMD_LLT_WARNING,
+                    "plg_lua: ['%s' missed %" PRIu64 " executions (%" PRIu64 " total)]",
                     env->name,
-                    lua_tostring(L, -1));
+                    m,
+                    env->missed);
         }
-        // pop result or error message
-        lua_pop(L, 1);
+    }
+    pthread_mutex_unlock(&s->mtx);
+    return NULL;
+}
+
+// schedule env (first execution is immediate)
+static int
+lua_env_sched_add(struct lua_env_sched *s, struct lua_env_d *env)
+{
+    pthread_mutex_lock(&s->mtx);
+    if (!s->running) {
+        pthread_mutex_unlock(&s->mtx);
+        return 1;
+    }
+    uint64_t now = lua_env_sched_now() - s->ts;
+    env->due = now;
+    umtw_add(s->tw, &env->tmr, now + lua_env_jitter(env));
+    pthread_cond_signal(&s->sched_cnd);
+    pthread_mutex_unlock(&s->mtx);
+    return 0;
+}
+
+// stop scheduler (running executions are finished,
+// queued executions are dropped)
+static void
+lua_env_sched_stop(struct lua_env_sched *s)
+{
+    if (s->tw == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&s->mtx);
+    bool r = s->running;
+    s->running = false;
+    pthread_cond_broadcast(&s->sched_cnd);
+    pthread_cond_broadcast(&s->wrk_cnd);
+    pthread_mutex_unlock(&s->mtx);
+    if (r) {
+        pthread_join(s->th, NULL);
+    }
+    for (int i = 0; i < s->wrks_n; i++) {
+        pthread_join(s->wrks[i], NULL);
+    }
+    pthread_cond_destroy(&s->wrk_cnd);
+    pthread_cond_destroy(&s->sched_cnd);
+    pthread_mutex_destroy(&s->mtx);
+    umtw_free(s->tw);
+    s->tw = NULL;
+    free(s->wrks);
+    s->wrks = NULL;
+}
+
+static int
+lua_env_sched_start(struct lua_env_sched *s)
+{
+    s->ts = lua_env_sched_now();
+    s->tw = umtw_new(0);
+    s->wrks = calloc(s->wrks_n, sizeof(pthread_t));
+    if (s->tw == NULL || s->wrks == NULL) {
+        umtw_free(s->tw);
+        free(s->wrks);
+        s->tw = NULL;
+        s->wrks = NULL;
+        return 1;
+    }
+    pthread_mutex_init(&s->mtx, NULL);
+    // monotonic clock for timed waits
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&s->sched_cnd, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_cond_init(&s->wrk_cnd, NULL);
+    s->running = true;
+    // scheduler and workers
+    if (pthread_create(&s->th, NULL, &th_lua_sched, s)) {
+        s->running = false;
+        s->wrks_n = 0;
+        pthread_cond_destroy(&s->wrk_cnd);
+        pthread_cond_destroy(&s->sched_cnd);
+        pthread_mutex_destroy(&s->mtx);
+        umtw_free(s->tw);
+        free(s->wrks);
+        s->tw = NULL;
+        s->wrks = NULL;
+        return 2;
+    }
+    int i = 0;
+    for (; i < s->wrks_n; i++) {
+        if (pthread_create(&s->wrks[i], NULL, &th_lua_worker, s)) {
+            break;
+        }
+    }
+    s->wrks_n = i;
+    // no workers, stop scheduler thread and free
+    if (i == 0) {
+        lua_env_sched_stop(s);
+        return 3;
+    }
+    return 0;
+}
 
-        // one-time only
-        if (env->interval == 0) {
+/*****************************/
+/* LUA signal handler (pool) */
+/*****************************/
+static struct lua_sh_pool *
+lua_sh_pool_new(struct lua_env_d *env, const char *sig)
+{
+    struct lua_sh_pool *p = calloc(1, sizeof(struct lua_sh_pool));
+    if (p == NULL) {
+        return NULL;
+    }
+    p->workers = calloc(env->workers, sizeof(struct lua_sh_worker));
+    if (p->workers == NULL) {
+        free(p);
+        return NULL;
+    }
+    pthread_mutex_init(&p->mtx, NULL);
+    pthread_cond_init(&p->cond, NULL);
+    // pre-load lua states
+    for (int i = 0; i < env->workers; i++) {
+        p->workers[i].L = lua_env_new_state(env, sig);
+        if (p->workers[i].L == NULL) {
             break;
+        }
+        p->free |= (1ULL << i);
+        p->sz++;
+    }
+    return p;
+}
 
-            // next iteration
-        } else {
-            nanosleep(&st, NULL);
+static void
+lua_sh_pool_free(struct lua_sh_pool *p)
+{
+    for (int i = 0; i < p->sz; i++) {
+        lua_env_close_state(p->workers[i].L);
+    }
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->mtx);
+    free(p->workers);
+    free(p);
+}
+
+// try to checkout a free lua state (lock-free)
+static int
+lua_sh_pool_try_get(struct lua_sh_pool *p)
+{
+    uint64_t f = UM_ATOMIC_GET(&p->free);
+    while (f != 0) {
+        // lowest free state
+        int i = __builtin_ctzll(f);
+        uint64_t o = UM_ATOMIC_COMP_SWAP(&p->free, f, f & ~(1ULL << i));
+        // state acquired
+        if (o == f) {
+            return i;
         }
+        // retry with current mask
+        f = o;
     }
-    // remove lua state
-    lua_close(L);
-    umd_log(UMD, UMD_LLT_INFO, "plg_lua: [stopping '%s' Lua environment]", env->name);
+    // all states in use
+    return -1;
+}
 
-    return NULL;
+// checkout lua state; wait if all states are in use
+static int
+lua_sh_pool_get(struct lua_sh_pool *p)
+{
+    // fast path
+    int i = lua_sh_pool_try_get(p);
+    if (i >= 0) {
+        return i;
+    }
+    // slow path
+    pthread_mutex_lock(&p->mtx);
+    UM_ATOMIC_ADD_F(&p->waiting, 1);
+    while ((i = lua_sh_pool_try_get(p)) < 0) {
+        pthread_cond_wait(&p->cond, &p->mtx);
+    }
+    UM_ATOMIC_SUB_F(&p->waiting, 1);
+    pthread_mutex_unlock(&p->mtx);
+    return i;
+}
+
+// return lua state to pool
+static void
+lua_sh_pool_put(struct lua_sh_pool *p, int i)
+{
+    UM_ATOMIC_F_OR(&p->free, 1ULL << i);
+    // wake up waiting threads
+    if (UM_ATOMIC_GET(&p->waiting) > 0) {
+        pthread_mutex_lock(&p->mtx);
+        pthread_cond_broadcast(&p->cond);
+        pthread_mutex_unlock(&p->mtx);
+    }
+}
+
+// check if current thread is already running this handler
+static bool
+lua_sh_pool_is_owner(struct lua_sh_pool *p)
+{
+    pthread_t self = pthread_self();
+    for (int i = 0; i < p->sz; i++) {
+        struct lua_sh_worker *w = &p->workers[i];
+        if (UM_ATOMIC_GET(&w->running) && pthread_equal(w->owner, self)) {
+            return true;
+        }
+    }
+    return false;
 }
 
 // lua signal handler (term)
 static int
 lua_sig_hndlr_term(umplg_sh_t *shd)
 {
-    // get lua state
-    lua_State **L = utarray_eltptr(shd->args, 2);
-    lua_close(*L);
+    // get lua state pool
+    struct lua_sh_pool **p = utarray_eltptr(shd->args, 2);
+    lua_sh_pool_free(*p);
     pthread_mutex_destroy(&shd->mtx);
 
     return 0;
@@ -338,152 +1350,163 @@ lua_sig_hndlr_init(umplg_sh_t *shd)
     // get lua env
     struct lua_env_d **env = utarray_eltptr(shd->args, 1);
 
-    // lua state
-    lua_State *L = luaL_newstate();
-    if (!L) {
-        umd_log(UMD, UMD_LLT_ERROR, "plg_lua: [cannot create Lua environment]");
+    // create pre-loaded lua states
+    struct lua_sh_pool *p = lua_sh_pool_new(*env, shd->id);
+    if (p == NULL) {
         return 1;
     }
-    // init lua
-    luaL_openlibs(L);
+    if (p->sz == 0) {
+        lua_sh_pool_free(p);
+        return 1;
+    }
+    // save state pool
+    utarray_push_back(shd->args, &p);
 
-    // init umink lua module
-    luaL_newlib(L, mink_lualib);
-    lua_setglobal(L, "M");
+    // success
+    return 0;
+}
 
-    // table key = address of pm pointer
-    // =================================
-    // registry[&env->pm] = pm
-    lua_pushstring(L, "mink_pm");
-    lua_pushlightuserdata(L, (*env)->pm);
+// checkout lua state and run handler script (results
+// are left on stack); returns state index or -1 if
+// signal recursion was prevented
+static int
+lua_sig_hndlr_call(umplg_sh_t *shd, umplg_data_std_t *d_in, int nres)
+{
+    // get lua state pool
+    struct lua_sh_pool **p = utarray_eltptr(shd->args, 2);
+    // recursion prevention
+    if (lua_sh_pool_is_owner(*p)) {
+        return -1;
+    }
+
+    // checkout lua state
+    int wi = lua_sh_pool_get(*p);
+    struct lua_sh_worker *w = &(*p)->workers[wi];
+    w->owner = pthread_self();
+    UM_ATOMIC_COMP_SWAP(&w->running, 0, 1);
+    lua_State *L = w->L;
+
+    // copy precompiled lua chunk (pcall removes it)
+    lua_pushvalue(L, -1);
+
+    // registry[&env->pm] = d_in
+    lua_pushstring(L, "mink_stdd");
+    lua_pushlightuserdata(L, d_in);
     lua_settable(L, LUA_REGISTRYINDEX);
 
-    // load lua script
-    FILE *f = fopen((*env)->path, "r");
-    if (f == NULL) {
-        printf("fopen err: %s %s\n", (*env)->name, (*env)->path);
-        return 2;
-    }
-    if (fseek(f, 0, SEEK_END) < 0) {
-        fclose(f);
-        return 3;
-    }
-    int32_t fsz = ftell(f);
-    if (fsz <= 0) {
-        fclose(f);
-        return 4;
+    // run lua script (error message is
+    // returned as single result)
+    int top = lua_gettop(L) - 1;
+    if (lua_pcall(L, 0, nres, 0)) {
+        umd_log(UMD, UMD_LLT_ERROR, "plg_lua: [%s]:%s", shd->id, lua_tostring(L, -1));
     }
+    // keep precompiled chunk only
+    w->top = top;
+    return wi;
+}
 
-    char lua_s[fsz + 1];
-    memset(lua_s, 0, fsz + 1);
-    rewind(f);
-    fread(lua_s, fsz, 1, f);
-    fclose(f);
+// pop results and return lua state to pool
+static void
+lua_sig_hndlr_release(umplg_sh_t *shd, int wi)
+{
+    struct lua_sh_pool **p = utarray_eltptr(shd->args, 2);
+    struct lua_sh_worker *w = &(*p)->workers[wi];
+    lua_State *L = w->L;
+    // pop results or error message
+    lua_settop(L, w->top);
+    // invalidate args proxies kept by script
+    // (d_in is released by caller)
+    lua_pushstring(L, "mink_stdd");
+    lua_pushnil(L);
+    lua_settable(L, LUA_REGISTRYINDEX);
+    // return lua state to pool
+    UM_ATOMIC_COMP_SWAP(&w->running, 1, 0);
+    lua_sh_pool_put(*p, wi);
+}
 
-    // load lua script
-    if (luaL_loadstring(L, lua_s)) {
-        umd_log(UMD,
-                UMD_LLT_ERROR,
-                "plg_lua: [cannot load Lua environment (%s)]:%s",
-                (*env)->name,
-                lua_tostring(L, -1));
-        lua_close(L);
-        return 5;
+// signal recursion error message
+static char *
+lua_sig_hndlr_rec_err(umplg_sh_t *shd, size_t *sz)
+{
+    // custom error message; cannot use luaL_error because of long jump
+    const char *err_msg = "ERR [%s]: signal recursion prevented";
+    *sz = snprintf(NULL, 0, err_msg, shd->id);
+    char *out = malloc(*sz + 1);
+    if (out != NULL) {
+        snprintf(out, *sz + 1, err_msg, shd->id);
     }
-    // save state
-    utarray_push_back(shd->args, &L);
-
-    // success
-    return 0;
+    return out;
 }
 
 // lua signal handler (run)
 static int
 lua_sig_hndlr_run(umplg_sh_t *shd, umplg_data_std_t *d_in, char **d_out, size_t *out_sz)
 {
-    // get lua state
-    lua_State **L = utarray_eltptr(shd->args, 2);
-    // lock
-    pthread_mutex_lock(&shd->mtx);
-    // recursion prevention
-    if (shd->running) {
-        shd->running = false;
-
-        // custom error message; cannot use luaL_error because of long jump
-        const char *err_msg = "ERR [%s]: signal recursion prevented";
-        size_t sz = snprintf(NULL, 0, err_msg, shd->id);
-        char *out = malloc(sz + 1);
-        snprintf(out, sz + 1, err_msg, shd->id);
-
-        // set output and unlock
-        *d_out = out;
-        *out_sz = sz + 1;
-        pthread_mutex_unlock(&shd->mtx);
+    // run script (single result)
+    int wi = lua_sig_hndlr_call(shd, d_in, 1);
+    if (wi < 0) {
+        size_t sz = 0;
+        *d_out = lua_sig_hndlr_rec_err(shd, &sz);
+        *out_sz = (*d_out != NULL ? sz + 1 : 0);
         return 0;
     }
+    struct lua_sh_pool **p = utarray_eltptr(shd->args, 2);
+    lua_State *L = (*p)->workers[wi].L;
+    int res = 0;
 
-    // copy precompiled lua chunk (pcall removes it)
-    lua_pushvalue(*L, -1);
-
-    // registry[&env->pm] = d_in
-    lua_pushstring(*L, "mink_stdd");
-    lua_pushlightuserdata(*L, d_in);
-    lua_settable(*L, LUA_REGISTRYINDEX);
-
-    // run lua script
-    shd->running = true;
-    if (lua_pcall(*L, 0, 1, 0)) {
-        umd_log(UMD, UMD_LLT_ERROR, "plg_lua: [%s]:%s", shd->id, lua_tostring(*L, -1));
-    }
-    // check return (STRING)
-    if (lua_isstring(*L, -1)) {
+    // check return (STRING or NUMBER, numbers are
+    // converted with lua formatting)
+    if (lua_isstring(L, -1)) {
         // copy lua string to output buffer
-        size_t sz = strlen(lua_tostring(*L, -1)) + 1;
-        char *out = malloc(sz);
-        int r = snprintf(out, sz, "%s", lua_tostring(*L, -1));
-        // error (buffer too small)
-        if (r <= 0 || r >= sz) {
-            free(out);
+        size_t l = 0;
+        const char *v = lua_tolstring(L, -1, &l);
+        char *out = malloc(l + 1);
+        if (out == NULL) {
             *out_sz = 0;
-            // pop result or error message
-            lua_pop(*L, 1);
-            shd->running = false;
-            pthread_mutex_unlock(&shd->mtx);
-            return 1;
+            res = 1;
 
             // success
         } else {
+            memcpy(out, v, l);
+            out[l] = '\0';
             *d_out = out;
-            *out_sz = sz;
+            *out_sz = l + 1;
         }
+    }
+    lua_sig_hndlr_release(shd, wi);
 
-        // NUMBER
-    } else if (lua_isnumber(*L, -1)) {
-        // copy lua number to output buffer
-        size_t sz = 256;
-        char *out = malloc(256);
-        int r = snprintf(out, sz, "%f", lua_tonumber(*L, -1));
-        // error (buffer too small)
-        if (r <= 0 || r >= sz) {
-            *out_sz = 0;
-            // pop result or error message
-            lua_pop(*L, 1);
-            shd->running = false;
-            pthread_mutex_unlock(&shd->mtx);
-            return 1;
+    return res;
+}
 
-            // success
-        } else {
-            *d_out = out;
-            *out_sz = sz;
+// lua signal handler (run, structured output); each
+// returned value is converted to std data rows
+static int
+lua_sig_hndlr_run_stdd(umplg_sh_t *shd, umplg_data_std_t *d_in, umplg_data_std_t *d_out)
+{
+    // run script (all results)
+    int wi = lua_sig_hndlr_call(shd, d_in, LUA_MULTRET);
+    if (wi < 0) {
+        size_t sz = 0;
+        char *err = lua_sig_hndlr_rec_err(shd, &sz);
+        umplg_stdd_row_t *row = umplg_stdd_row_new(d_out, 1);
+        umplg_stdd_col_add_copy(d_out, row, "", err, (err != NULL ? sz : 0));
+        free(err);
+        return 0;
+    }
+    struct lua_sh_pool **p = utarray_eltptr(shd->args, 2);
+    struct lua_sh_worker *w = &(*p)->workers[wi];
+    int res = 0;
+
+    // convert results (copied to output arena)
+    for (int i = w->top + 1; i <= lua_gettop(w->L); i++) {
+        if (mink_lua_to_stdd(w->L, i, d_out)) {
+            res = 1;
+            break;
         }
     }
-    // pop result or error message
-    lua_pop(*L, 1);
-    shd->running = false;
-    pthread_mutex_unlock(&shd->mtx);
-    // success
-    return 0;
+    lua_sig_hndlr_release(shd, wi);
+
+    return res;
 }
 
 // process plugin configuration
@@ -517,7 +1540,7 @@ process_cfg(umplg_mngr_t *pm, struct lua_env_mngr *lem)
     struct json_object *jobj = json_object_object_get(plg_cfg, "cmd_call");
     if (jobj != NULL) {
         // create ENV descriptor
-        struct lua_env_d *env = malloc(sizeof(struct lua_env_d));
+        struct lua_env_d *env = calloc(1, sizeof(struct lua_env_d));
         env->name = strdup("CMD_CALL");
         env->interval = 0;
         UM_ATOMIC_COMP_SWAP(&env->active, 0, 1);
@@ -525,6 +1548,37 @@ process_cfg(umplg_mngr_t *pm, struct lua_env_mngr *lem)
         // add to list
         lenvm_new_envd(lem, env);
     }
+    // number of env worker threads (optional)
+    jobj = json_object_object_get(plg_cfg, "env_workers");
+    if (jobj != NULL && json_object_is_type(jobj, json_type_int)) {
+        int wrk = json_object_get_int(jobj);
+        if (wrk < 1 || wrk > LUA_ENV_WORKERS_MAX) {
+            umd_log(UMD,
+                    UMD_LLT_WARNING,
+                    "plg_lua: [invalid number of env workers (1 - %d)]",
+                    LUA_ENV_WORKERS_MAX);
+            wrk = (wrk < 1 ? 1 : LUA_ENV_WORKERS_MAX);
+        }
+        lem->sched.wrks_n = wrk;
+    }
+    // bytecode cache dir (optional, must not be
+    // writable by untrusted users)
+    jobj = json_object_object_get(plg_cfg, "bytecode_cache");
+    if (jobj != NULL && json_object_is_type(jobj, json_type_string)) {
+        const char *d = json_object_get_string(jobj);
+        struct stat st;
+        if (mkdir(d, 0700) && errno != EEXIST) {
+            umd_log(UMD, UMD_LLT_WARNING, "plg_lua: [cannot create bytecode cache (%s)]", d);
+        } else if (lstat(d, &st) || !lua_bc_trusted(&st, S_IFDIR)) {
+            umd_log(UMD,
+                    UMD_LLT_WARNING,
+                    "plg_lua: [bytecode cache must be a directory owned by daemon user "
+                    "and not writable by others, cache disabled (%s)]",
+                    d);
+        } else {
+            lem->bc_dir = strdup(d);
+        }
+    }
     // get envs
     jobj = json_object_object_get(plg_cfg, "envs");
     if (jobj != NULL && json_object_is_type(jobj, json_type_array)) {
@@ -547,6 +1601,9 @@ process_cfg(umplg_mngr_t *pm, struct lua_env_mngr *lem)
             struct json_object *j_int = json_object_object_get(v, "interval");
             struct json_object *j_p = json_object_object_get(v, "path");
             struct json_object *j_ev = json_object_object_get(v, "events");
+            struct json_object *j_wrk = json_object_object_get(v, "workers");
+            struct json_object *j_jit = json_object_object_get(v, "jitter");
+            struct json_object *j_mem = json_object_object_get(v, "mem_limit");
             // all values are mandatory
             if (!(j_n && j_as && j_int && j_p && j_ev)) {
                 umd_log(UMD,
@@ -593,6 +1650,34 @@ process_cfg(umplg_mngr_t *pm, struct lua_env_mngr *lem)
             env->pm = pm;
             UM_ATOMIC_COMP_SWAP(&env->active, 0, json_object_get_boolean(j_as));
             env->path = strdup(json_object_get_string(j_p));
+            // number of Lua states per event (optional)
+            env->workers = 1;
+            if (j_wrk != NULL && json_object_is_type(j_wrk, json_type_int)) {
+                int wrk = json_object_get_int(j_wrk);
+                if (wrk < 1 || wrk > LUA_SH_POOL_MAX) {
+                    umd_log(UMD,
+                            UMD_LLT_WARNING,
+                            "plg_lua: [invalid number of workers for '%s' (1 - %d)]",
+                            env->name,
+                            LUA_SH_POOL_MAX);
+                    wrk = (wrk < 1 ? 1 : LUA_SH_POOL_MAX);
+                }
+                env->workers = wrk;
+            }
+            // random execution delay (optional, less than interval)
+            if (j_jit != NULL && json_object_is_type(j_jit, json_type_int) &&
+                json_object_get_int64(j_jit) > 0 && env->interval > 0) {
+                env->jitter = json_object_get_uint64(j_jit);
+                if (env->jitter >= env->interval) {
+                    env->jitter = env->interval - 1;
+                }
+                env->seed = (unsigned int)(uintptr_t)env ^ (unsigned int)time(NULL);
+            }
+            // memory limit per Lua state (optional, bytes)
+            if (j_mem != NULL && json_object_is_type(j_mem, json_type_int) &&
+                json_object_get_int64(j_mem) > 0) {
+                env->mem_limit = json_object_get_uint64(j_mem);
+            }
 
             // register events
             int ev_l = json_object_array_length(j_ev);
@@ -605,9 +1690,11 @@ process_cfg(umplg_mngr_t *pm, struct lua_env_mngr *lem)
                     continue;
                 }
                 // create signal
-                umplg_sh_t *sh = malloc(sizeof(umplg_sh_t));
+                umplg_sh_t *sh = calloc(1, sizeof(umplg_sh_t));
                 sh->id = strdup(json_object_get_string(v2));
+                sh->flags = UMPLG_FEAT_STDD_ZC;
                 sh->run = &lua_sig_hndlr_run;
+                sh->run_stdd = &lua_sig_hndlr_run_stdd;
                 sh->init = &lua_sig_hndlr_init;
                 sh->term = &lua_sig_hndlr_term;
                 sh->running = false;
@@ -638,25 +1725,59 @@ process_cfg(umplg_mngr_t *pm, struct lua_env_mngr *lem)
     return 0;
 }
 
+// one-time env (own thread, might run for a long
+// time and should not occupy scheduler workers)
+static void *
+th_lua_env_once(void *arg)
+{
+    struct lua_env_d *env = arg;
+    if (UM_ATOMIC_GET(&env->active) && !umd_is_terminating()) {
+        lua_env_run(env);
+    }
+    return NULL;
+}
+
 static void
 process_lua_envs(struct lua_env_d *env)
 {
     // check if ENV should auto-start
-    if (env->interval >= 0 && env->active && strcmp(env->name, "CMD_CALL") != 0) {
-        if (pthread_create(&env->th, NULL, th_lua_env, env)) {
+    if (!env->active || strcmp(env->name, "CMD_CALL") == 0) {
+        return;
+    }
+    // one-time
+    if (env->interval == 0) {
+        env->th_started = (pthread_create(&env->th, NULL, &th_lua_env_once, env) == 0);
+        if (!env->th_started) {
             umd_log(UMD,
                     UMD_LLT_ERROR,
                     "plg_lua: [cannot start [%s] environment",
                     env->name);
         }
+
+        // periodic
+    } else if (lua_env_sched_add(&lenv_mngr->sched, env)) {
+        umd_log(UMD,
+                UMD_LLT_ERROR,
+                "plg_lua: [cannot start [%s] environment",
+                env->name);
     }
 }
 
 static void
 shutdown_lua_envs(struct lua_env_d *env)
 {
-    if (strcmp(env->name, "CMD_CALL") != 0 && UM_ATOMIC_GET(&env->active)) {
+    // wait for one-time env
+    if (env->th_started) {
         pthread_join(env->th, NULL);
+        env->th_started = false;
+    }
+    // close lua state (scheduler stopped)
+    if (env->L != NULL) {
+        lua_env_close_state(env->L);
+        umd_log(UMD,
+                UMD_LLT_INFO,
+                "plg_lua: [stopping '%s' Lua environment]",
+                env->name);
     }
     // cleanup
     lenvm_del_envd(lenv_mngr, env->name, false);
@@ -676,8 +1797,12 @@ init(umplg_mngr_t *pm, umplgd_t *pd)
     if (process_cfg(pm, lenv_mngr)) {
         umd_log(UMD, UMD_LLT_ERROR, "plg_lua: [cannot process plugin configuration]");
     }
-    // create environments
-    lenvm_process_envs(lenv_mngr, &process_lua_envs);
+    // start env scheduler and create environments
+    if (lua_env_sched_start(&lenv_mngr->sched)) {
+        umd_log(UMD, UMD_LLT_ERROR, "plg_lua: [cannot start Lua env scheduler]");
+    } else {
+        lenvm_process_envs(lenv_mngr, &process_lua_envs);
+    }
 
     return 0;
 }
@@ -688,21 +1813,75 @@ init(umplg_mngr_t *pm, umplgd_t *pd)
 int
 terminate(umplg_mngr_t *pm, umplgd_t *pd)
 {
-    // stop envs
+    // stop scheduler and envs
+    lua_env_sched_stop(&lenv_mngr->sched);
     lenvm_process_envs(lenv_mngr, &shutdown_lua_envs);
     // free env manager
     lenvm_free(lenv_mngr);
     return 0;
 }
 
+/***********************/
+/* local CMD_LUA_STATS */
+/***********************/
+// one row per lua state (counters are read
+// while states are running, approximate)
+static void
+impl_lua_stats(umplg_data_std_t *data)
+{
+    pthread_mutex_lock(&lenv_mngr->mems_mtx);
+    struct lua_mem *m = NULL;
+    struct lua_mem *tmp = NULL;
+    HASH_ITER(hh, lenv_mngr->mems, m, tmp)
+    {
+        umplg_stdd_row_t *row = umplg_stdd_row_new(data, 9);
+        if (row == NULL) {
+            break;
+        }
+        const char *sig = (m->sig != NULL ? m->sig : "");
+        umplg_stdd_col_add_copy(data, row, "env", m->env, strlen(m->env));
+        umplg_stdd_col_add_copy(data, row, "signal", sig, strlen(sig));
+        umplg_stdd_col_add_int(data, row, "used", UM_ATOMIC_GET(&m->used));
+        umplg_stdd_col_add_int(data, row, "peak", UM_ATOMIC_GET(&m->peak));
+        umplg_stdd_col_add_int(data, row, "pool", UM_ATOMIC_GET(&m->pool));
+        umplg_stdd_col_add_int(data, row, "large", UM_ATOMIC_GET(&m->large));
+        umplg_stdd_col_add_int(data, row, "limit", UM_ATOMIC_GET(&m->limit));
+        umplg_stdd_col_add_int(data, row, "allocs", UM_ATOMIC_GET(&m->allocs));
+        umplg_stdd_col_add_int(data, row, "denied", UM_ATOMIC_GET(&m->denied));
+    }
+    pthread_mutex_unlock(&lenv_mngr->mems_mtx);
+}
+
 /*************************/
 /* local command handler */
 /*************************/
 int
 run_local(umplg_mngr_t *pm, umplgd_t *pd, int cmd_id, umplg_idata_t *data)
 {
-    // unused
-    return 0;
+    // null checks
+    if (data == NULL) {
+        return -1;
+    }
+
+    // plugin2plugin local interface (standard)
+    if (data->type == UMPLG_DT_STANDARD) {
+        // plugin input data
+        umplg_data_std_t *plg_d = data->data;
+        // check command id
+        switch (cmd_id) {
+        case CMD_LUA_STATS:
+            impl_lua_stats(plg_d);
+            break;
+
+        default:
+            break;
+        }
+
+        return 0;
+    }
+
+    // unsupported interface
+    return -2;
 }
 
 /*******************/
@@ -8,162 +8,1154 @@
  *
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <time.h>
+#include <libgen.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
 #include <mosquitto.h>
 #include <mosquitto_plugin.h>
+#include <mosquitto_broker.h>
+#include <uthash.h>
+#include <umatomic.h>
+#include <umtopic.h>
+#include <utarray.h>
 #include <umdb.h>
 
+// min interval between db change checks (ms)
+#define DB_CHECK_INTERVAL 1000
+
+// verified credential cache defaults (ttl in seconds)
+#define CRED_CACHE_TTL_DEF  300
+#define CRED_CACHE_SIZE_DEF 1024
+
+// ACL decision cache defaults (ttl in seconds)
+#define ACL_CACHE_TTL_DEF  60
+#define ACL_CACHE_SIZE_DEF 4096
+
+// db change debounce (ms)
+#define USR_SNAP_DEBOUNCE 200
+
+// user snapshot entry
+struct usr_snap_e {
+    // username (key)
+    const char *usr;
+    // stored credential
+    const char *pwd;
+    // user id and flags
+    int id;
+    int flags;
+    // hashable
+    UT_hash_handle hh;
+    // usr/pwd storage
+    char buf[];
+};
+
+// user snapshot (immutable once published)
+struct usr_snap {
+    // username -> entry
+    struct usr_snap_e *tbl;
+    // compiled ACL rules (NULL = legacy ACL)
+    struct acl_rules *acl;
+};
+
+// compiled ACL rule
+struct acl_rule {
+    // username (NULL = any user)
+    char *usr;
+    // user flags/group (-1 = any group)
+    int flags;
+    // allowed access (MOSQ_ACL_*)
+    int access;
+};
+
+// compiled ACL rules (topic pattern trie)
+struct acl_rules {
+    // pattern -> rules
+    umtopic_trie_t *trie;
+    // rules (owned)
+    UT_array *rules;
+};
+
+// ACL evaluation context
+struct acl_eval {
+    const char *usr;
+    int flags;
+    int access;
+    bool allow;
+};
+
+// verified credential cache entry
+struct cred_cache_e {
+    // HMAC(secret, user, password, stored credential)
+    unsigned char key[32];
+    // expiry (monotonic, ms)
+    uint64_t exp;
+    // hashable
+    UT_hash_handle hh;
+};
+
+// verified credential cache (successful KDF
+// verifications only)
+struct cred_cache {
+    // entries (insertion ordered)
+    struct cred_cache_e *tbl;
+    // ttl (ms), 0 = cache disabled
+    uint64_t ttl;
+    // max number of entries
+    size_t max;
+    // per-process HMAC key
+    unsigned char secret[32];
+    // entries lock (KDF runs unlocked)
+    pthread_mutex_t mtx;
+};
+
+// ACL decision cache entry
+struct acl_cache_e {
+    // expiry (monotonic, ms)
+    uint64_t exp;
+    // cached decision (MOSQ_ERR_*)
+    int res;
+    // hashable
+    UT_hash_handle hh;
+    // access\0user\0client id\0topic
+    char key[];
+};
+
+// ACL decision cache (broker thread only)
+struct acl_cache {
+    // entries (insertion ordered)
+    struct acl_cache_e *tbl;
+    // ttl (ms), 0 = cache disabled
+    uint64_t ttl;
+    // max number of entries
+    size_t max;
+    // user record generation of cached
+    // decisions (cleared when changed)
+    unsigned int gen;
+};
+
+// per-client context (resolved on connect,
+// reused for ACL events)
+struct client_ctx {
+    // client (key)
+    const struct mosquitto *client;
+    // username and client id
+    char *usr;
+    char *clid;
+    // resolved user record (id < 1 = not found)
+    int id;
+    int flags;
+    // user record generation
+    unsigned int gen;
+    // hashable
+    UT_hash_handle hh;
+};
+
+// plugin id
+static mosquitto_plugin_id_t *plg_id = NULL;
 // mink db
 static char *db_name = NULL;
 // db manager
 static umdb_mngrd_t *dbm = NULL;
+// last seen db data version (db mode)
+static int db_ver = -1;
+// last db change check (ms)
+static uint64_t db_ver_ts = 0;
+// ACL rules (db mode, user snapshot disabled)
+static struct acl_rules *acl_db = NULL;
+// ACL rules loaded from db (not a fallback)
+static bool acl_db_ok = false;
+// verified credential cache
+static struct cred_cache cred_cache = { .ttl = CRED_CACHE_TTL_DEF * 1000,
+                                        .max = CRED_CACHE_SIZE_DEF,
+                                        .mtx = PTHREAD_MUTEX_INITIALIZER };
+// ACL decision cache
+static struct acl_cache acl_cache = { .ttl = ACL_CACHE_TTL_DEF * 1000,
+                                      .max = ACL_CACHE_SIZE_DEF };
+// user snapshot enabled
+static bool snap_enabled = true;
+// current snapshot (broker thread only)
+static struct usr_snap *snap_cur = NULL;
+// new snapshot published by watcher thread
+static struct usr_snap *snap_pend = NULL;
+// db file watcher (created = must be joined,
+// running = should keep watching)
+static pthread_t snap_th;
+static bool snap_th_created = false;
+static int snap_th_running = 0;
+// connected clients (broker thread only)
+static struct client_ctx *clients = NULL;
+// user record generation (bumped when user
+// snapshot or db changes)
+static unsigned int usr_gen = 0;
 
-// plugin version 4
-int
-mosquitto_auth_plugin_version()
+/*************/
+/* ACL rules */
+/*************/
+static void
+acl_rules_free(struct acl_rules *a)
 {
-    return MOSQ_AUTH_PLUGIN_VERSION;
+    if (a == NULL) {
+        return;
+    }
+    struct acl_rule **r = NULL;
+    while ((r = utarray_next(a->rules, r))) {
+        free((*r)->usr);
+        free(*r);
+    }
+    utarray_free(a->rules);
+    umtopic_free(a->trie);
+    free(a);
 }
 
-// Called after the plugin has been loaded and mosquitto_auth_plugin_version
-// has been called.  This will only ever be called once and can be used to
-// initialise the plugin.
-int
-mosquitto_auth_plugin_init(void **user_data, struct mosquitto_opt *opts, int opt_count)
+static int
+acl_rules_add(const umdb_acl_d_t *acl, void *arg)
 {
-    // process options
-    for (int i = 0; i < opt_count; i++) {
-        if (strncmp(opts[i].key, "db_name", 7) == 0) {
-            db_name = opts[i].value;
-        }
+    struct acl_rules *a = arg;
+    struct acl_rule *r = calloc(1, sizeof(struct acl_rule));
+    if (r == NULL) {
+        return 1;
     }
-    // missing db options
-    if (db_name == NULL) {
+    r->usr = (acl->usr != NULL ? strdup(acl->usr) : NULL);
+    r->flags = acl->flags;
+    r->access = acl->access;
+    if (umtopic_add(a->trie, acl->topic, r)) {
+        mosquitto_log_printf(MOSQ_LOG_WARNING,
+                             "plg_mosquitto_auth: invalid ACL pattern [%s]",
+                             acl->topic);
+        free(r->usr);
+        free(r);
+        return 0;
+    }
+    utarray_push_back(a->rules, &r);
+    return 0;
+}
+
+static struct acl_rules *
+acl_rules_new()
+{
+    struct acl_rules *a = calloc(1, sizeof(struct acl_rules));
+    if (a == NULL) {
+        return NULL;
+    }
+    a->trie = umtopic_new();
+    if (a->trie == NULL) {
+        free(a);
+        return NULL;
+    }
+    utarray_new(a->rules, &ut_ptr_icd);
+    return a;
+}
+
+// load and compile ACL rules (*res is set to NULL
+// if acl table is missing or empty = legacy ACL);
+// on db error, *res is not modified
+static int
+acl_rules_load(struct acl_rules **res)
+{
+    struct acl_rules *a = acl_rules_new();
+    if (a == NULL) {
+        return 1;
+    }
+    int r = umdb_mngr_acl_list(dbm, &acl_rules_add, a);
+    if (r != 0 && r != UMDB_ACL_NO_TABLE) {
         mosquitto_log_printf(MOSQ_LOG_ERR,
-                             "plg_mosquitto_auth: db_name option is missing");
-        return MOSQ_ERR_AUTH;
+                             "plg_mosquitto_auth: cannot load ACL rules [%d]",
+                             r);
+        acl_rules_free(a);
+        return 2;
     }
-    // create umdbm and connect
-    dbm = umdb_mngr_new(db_name);
-    if (dbm == NULL) {
-        mosquitto_log_printf(MOSQ_LOG_ERR, "plg_mosquitto_auth: error while connecting");
-        return MOSQ_ERR_AUTH;
+    if (r == UMDB_ACL_NO_TABLE || utarray_len(a->rules) == 0) {
+        acl_rules_free(a);
+        a = NULL;
     }
+    *res = a;
+    return 0;
+}
 
-    // plugin initialised
-    return MOSQ_ERR_SUCCESS;
+// reload ACL rules (db mode), previous rules
+// are kept if rules cannot be loaded
+static int
+acl_db_reload()
+{
+    struct acl_rules *a = NULL;
+    if (acl_rules_load(&a)) {
+        return 1;
+    }
+    acl_rules_free(acl_db);
+    acl_db = a;
+    acl_db_ok = true;
+    return 0;
 }
 
-// Called when the broker is shutting down.  This will only ever be called once
-// per plugin.  Note that mosquitto_auth_security_cleanup will be called
-// directly before this function.
-int
-mosquitto_auth_plugin_cleanup(void *userdata,
-                              struct mosquitto_opt *options,
-                              int option_count)
+static void
+acl_rule_match(void *val, void *arg)
 {
-    return MOSQ_ERR_SUCCESS;
+    struct acl_rule *r = val;
+    struct acl_eval *e = arg;
+    // rule user/group
+    if (r->usr != NULL && strcmp(r->usr, e->usr) != 0) {
+        return;
+    }
+    if (r->flags >= 0 && r->flags != e->flags) {
+        return;
+    }
+    // subscribing is covered by read access (rules
+    // created with default access have no SUBSCRIBE bit)
+    int access = e->access;
+    if (access == MOSQ_ACL_SUBSCRIBE) {
+        access |= MOSQ_ACL_READ;
+    }
+    if (r->access & access) {
+        e->allow = true;
+    }
 }
 
-// Called:
-// 1. When the broker starts up.
-// 2. If the broker is requested to reload its configuration whilst running.
-//    In this case, mosquitto_auth_security_cleanup will be called first, then
-//    this function will be called.  In this situation, the reload parameter
-//    will be true.
-int
-mosquitto_auth_security_init(void *user_data,
-                             struct mosquitto_opt *opts,
-                             int opt_count,
-                             bool reload)
+/***********************/
+/* User snapshot utils */
+/***********************/
+static void
+usr_snap_free(struct usr_snap *s)
 {
-    return MOSQ_ERR_SUCCESS;
+    if (s == NULL) {
+        return;
+    }
+    acl_rules_free(s->acl);
+    struct usr_snap_e *e, *tmp;
+    HASH_ITER(hh, s->tbl, e, tmp)
+    {
+        HASH_DEL(s->tbl, e);
+        free(e);
+    }
+    free(s);
 }
 
-// Called:
-// 1. When the broker is shutting down.
-// 2. If the broker is requested to reload its configuration whilst running.
-//    In this case, this function will be called, followed by
-//    mosquitto_auth_security_init. In this situation, the reload parameter will be true.
-int
-mosquitto_auth_security_cleanup(void *user_data,
-                                struct mosquitto_opt *opts,
-                                int opt_count,
-                                bool reload)
+static int
+usr_snap_add(const umdb_uauth_d_t *u, const char *pwd, void *arg)
+{
+    struct usr_snap *s = arg;
+    size_t u_sz = strlen(u->usr);
+    size_t p_sz = strlen(pwd);
+    // single allocation (entry + strings)
+    struct usr_snap_e *e = malloc(sizeof(struct usr_snap_e) + u_sz + p_sz + 2);
+    if (e == NULL) {
+        return 1;
+    }
+    memcpy(e->buf, u->usr, u_sz + 1);
+    memcpy(&e->buf[u_sz + 1], pwd, p_sz + 1);
+    e->usr = e->buf;
+    e->pwd = &e->buf[u_sz + 1];
+    e->id = u->id;
+    e->flags = u->flags;
+    // duplicate usernames, keep first
+    struct usr_snap_e *tmp = NULL;
+    HASH_FIND(hh, s->tbl, e->usr, u_sz, tmp);
+    if (tmp != NULL) {
+        free(e);
+        return 0;
+    }
+    HASH_ADD_KEYPTR(hh, s->tbl, e->usr, u_sz, e);
+    return 0;
+}
+
+static struct usr_snap *
+usr_snap_load()
 {
+    struct usr_snap *s = calloc(1, sizeof(struct usr_snap));
+    if (s == NULL) {
+        return NULL;
+    }
+    // ACL rules are part of the snapshot, on db error
+    // the whole snapshot is rejected (previous is kept)
+    if (umdb_mngr_ulist(dbm, &usr_snap_add, s) || acl_rules_load(&s->acl)) {
+        usr_snap_free(s);
+        return NULL;
+    }
+    return s;
+}
+
+// publish new snapshot (any thread)
+static void
+usr_snap_publish(struct usr_snap *s)
+{
+    struct usr_snap *o = NULL;
+    for (;;) {
+        o = UM_ATOMIC_COMP_SWAP(&snap_pend, NULL, NULL);
+        if (UM_ATOMIC_COMP_SWAP(&snap_pend, o, s) == o) {
+            break;
+        }
+    }
+    // replaced snapshot was never used
+    usr_snap_free(o);
+}
+
+// get current snapshot (broker thread)
+static struct usr_snap *
+usr_snap_get()
+{
+    struct usr_snap *p = UM_ATOMIC_COMP_SWAP(&snap_pend, NULL, NULL);
+    if (p != NULL && UM_ATOMIC_COMP_SWAP(&snap_pend, p, NULL) == p) {
+        usr_snap_free(snap_cur);
+        snap_cur = p;
+        usr_gen++;
+    }
+    return snap_cur;
+}
+
+// drain inotify events, check if db file was changed
+static bool
+usr_snap_drain(int fd, const char *base)
+{
+    bool changed = false;
+    size_t b_sz = strlen(base);
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t r;
+    while ((r = read(fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + r;) {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            // db, -wal or -journal file
+            if (ev->len > 0 && strncmp(ev->name, base, b_sz) == 0 &&
+                (ev->name[b_sz] == '\0' || ev->name[b_sz] == '-')) {
+                changed = true;
+            }
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+    return changed;
+}
+
+static void *
+usr_snap_watch(void *arg)
+{
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        mosquitto_log_printf(MOSQ_LOG_ERR, "plg_mosquitto_auth: cannot init inotify");
+        return NULL;
+    }
+    // watch db directory (db file might be replaced)
+    char *d_path = strdup(db_name);
+    char *b_path = strdup(db_name);
+    const char *base = basename(b_path);
+    if (inotify_add_watch(fd,
+                          dirname(d_path),
+                          IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE) < 0) {
+        mosquitto_log_printf(MOSQ_LOG_ERR, "plg_mosquitto_auth: cannot watch db file");
+        UM_ATOMIC_COMP_SWAP(&snap_th_running, 1, 0);
+    }
+    bool pending = false;
+    while (UM_ATOMIC_GET(&snap_th_running)) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        int r = poll(&pfd, 1, (pending ? USR_SNAP_DEBOUNCE : 500));
+        // events
+        if (r > 0) {
+            if (usr_snap_drain(fd, base)) {
+                pending = true;
+            }
+            continue;
+        }
+        // quiet period after change, reload
+        if (r == 0 && pending) {
+            pending = false;
+            struct usr_snap *s = usr_snap_load();
+            if (s != NULL) {
+                usr_snap_publish(s);
+                mosquitto_log_printf(MOSQ_LOG_INFO,
+                                     "plg_mosquitto_auth: user snapshot reloaded");
+            } else {
+                mosquitto_log_printf(MOSQ_LOG_ERR,
+                                     "plg_mosquitto_auth: cannot reload user snapshot");
+                // retry after next quiet period
+                pending = true;
+            }
+        }
+    }
+    free(d_path);
+    free(b_path);
+    close(fd);
+    return NULL;
+}
+
+// ACL decision
+static int
+acl_decide(struct acl_rules *rules,
+           const char *usr,
+           const char *clid,
+           int id,
+           int flags,
+           int access,
+           const char *topic)
+{
+    // not found
+    if (id < 1) {
+        return MOSQ_ERR_ACL_DENIED;
+    }
+    // topic pattern rules (allow if any rule matches)
+    if (rules != NULL) {
+        umtopic_subst_t subst[] = { { "%u", usr }, { "%c", clid } };
+        struct acl_eval e = { usr, flags, access, false };
+        umtopic_match_subst(rules->trie,
+                            topic,
+                            strlen(topic),
+                            subst,
+                            (clid != NULL ? 2 : 1),
+                            &acl_rule_match,
+                            &e);
+        return (e.allow ? MOSQ_ERR_SUCCESS : MOSQ_ERR_ACL_DENIED);
+    }
+    // legacy ACL, "admin" topic requested, check user flags
+    if (strncmp(topic, "mink/admin/", 11) == 0 && flags != 1) {
+        return MOSQ_ERR_ACL_DENIED;
+    }
     return MOSQ_ERR_SUCCESS;
 }
 
-// This function is OPTIONAL.  Only include this function in your plugin if you
-// are making basic username/password checks.  Called by the broker when a
-// username/password must be checked.
-int
-mosquitto_auth_unpwd_check(void *user_data,
-                           struct mosquitto *client,
-                           const char *username,
-                           const char *password)
+/*************/
+/* Db change */
+/*************/
+static uint64_t
+plg_now()
 {
-    // anonymous not allowed
-    if (username == NULL) {
-        return MOSQ_ERR_AUTH;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// recompile rules and re-resolve clients if user
+// db was modified (rate limited, PRAGMA data_version)
+static void
+db_check_version(uint64_t now)
+{
+    if (now - db_ver_ts < DB_CHECK_INTERVAL) {
+        return;
+    }
+    db_ver_ts = now;
+    int v = 0;
+    if (umdb_mngr_data_version(dbm, &v) || (v == db_ver && acl_db_ok)) {
+        return;
+    }
+    // on error, keep previous rules and retry on next check
+    if (db_ver != -1 || !acl_db_ok) {
+        if (acl_db_reload()) {
+            return;
+        }
+        usr_gen++;
+    }
+    db_ver = v;
+}
+
+/**************************/
+/* Credential cache utils */
+/**************************/
+static void
+cred_cache_clear(struct cred_cache *c)
+{
+    struct cred_cache_e *e, *tmp;
+    HASH_ITER(hh, c->tbl, e, tmp)
+    {
+        HASH_DEL(c->tbl, e);
+        free(e);
+    }
+}
+
+// cache key (credential digest)
+static int
+cred_cache_key(struct cred_cache *c,
+               const char *u,
+               const char *stored,
+               const char *p,
+               unsigned char *k)
+{
+    size_t u_sz = strlen(u);
+    size_t s_sz = strlen(stored);
+    size_t p_sz = strlen(p);
+    size_t sz = u_sz + s_sz + p_sz + 3;
+    // user\0stored\0password\0
+    char b_s[512];
+    char *b = (sz <= sizeof(b_s) ? b_s : malloc(sz));
+    if (b == NULL) {
+        return 1;
+    }
+    memcpy(b, u, u_sz + 1);
+    memcpy(&b[u_sz + 1], stored, s_sz + 1);
+    memcpy(&b[u_sz + s_sz + 2], p, p_sz + 1);
+    unsigned int k_sz = 0;
+    unsigned char *r = HMAC(EVP_sha256(),
+                            c->secret,
+                            sizeof(c->secret),
+                            (unsigned char *)b,
+                            sz,
+                            k,
+                            &k_sz);
+    OPENSSL_cleanse(b, sz);
+    if (b != b_s) {
+        free(b);
+    }
+    return (r == NULL || k_sz != 32);
+}
+
+// credential verification (umdb_cred_verify_t)
+static int
+cred_verify(const char *u, const char *stored, const char *p, void *arg)
+{
+    struct cred_cache *c = arg;
+    // plaintext or cache disabled
+    if (c->ttl == 0 || !umdb_cred_is_hashed(stored)) {
+        return umdb_cred_verify(stored, p);
+    }
+    unsigned char k[32];
+    if (cred_cache_key(c, u, stored, p, k)) {
+        return umdb_cred_verify(stored, p);
+    }
+    uint64_t now = plg_now();
+    struct cred_cache_e *e = NULL;
+    pthread_mutex_lock(&c->mtx);
+    HASH_FIND(hh, c->tbl, k, sizeof(k), e);
+    if (e != NULL) {
+        if (now < e->exp) {
+            pthread_mutex_unlock(&c->mtx);
+            return 1;
+        }
+        // expired
+        HASH_DEL(c->tbl, e);
+        free(e);
+    }
+    pthread_mutex_unlock(&c->mtx);
+    // run KDF
+    if (umdb_cred_verify(stored, p) != 1) {
+        return 0;
+    }
+    pthread_mutex_lock(&c->mtx);
+    // added by concurrent verification
+    HASH_FIND(hh, c->tbl, k, sizeof(k), e);
+    if (e != NULL) {
+        pthread_mutex_unlock(&c->mtx);
+        return 1;
+    }
+    // size limit reached, evict oldest
+    if (HASH_COUNT(c->tbl) >= c->max && c->tbl != NULL) {
+        struct cred_cache_e *o = c->tbl;
+        HASH_DEL(c->tbl, o);
+        free(o);
+    }
+    e = malloc(sizeof(struct cred_cache_e));
+    if (e != NULL) {
+        memcpy(e->key, k, sizeof(k));
+        e->exp = now + c->ttl;
+        HASH_ADD(hh, c->tbl, key, sizeof(e->key), e);
+    }
+    pthread_mutex_unlock(&c->mtx);
+    return 1;
+}
+
+/*******************/
+/* ACL cache utils */
+/*******************/
+static void
+acl_cache_clear(struct acl_cache *c)
+{
+    struct acl_cache_e *e, *tmp;
+    HASH_ITER(hh, c->tbl, e, tmp)
+    {
+        HASH_DEL(c->tbl, e);
+        free(e);
+    }
+}
+
+// cache key (access\0user\0client id\0topic), client
+// id is part of the key because of %c rule patterns
+static char *
+acl_cache_key(int access,
+              const char *usr,
+              const char *clid,
+              const char *topic,
+              char *b_s,
+              size_t b_sz,
+              size_t *sz)
+{
+    char a[16];
+    size_t a_sz = snprintf(a, sizeof(a), "%d", access);
+    size_t u_sz = strlen(usr);
+    size_t c_sz = (clid != NULL ? strlen(clid) : 0);
+    size_t t_sz = strlen(topic);
+    *sz = a_sz + u_sz + c_sz + t_sz + 3;
+    char *b = (*sz <= b_sz ? b_s : malloc(*sz));
+    if (b == NULL) {
+        return NULL;
+    }
+    char *k = b;
+    memcpy(k, a, a_sz + 1);
+    k += a_sz + 1;
+    memcpy(k, usr, u_sz + 1);
+    k += u_sz + 1;
+    memcpy(k, (clid != NULL ? clid : ""), c_sz + 1);
+    k += c_sz + 1;
+    memcpy(k, topic, t_sz);
+    return b;
+}
+
+// find cached decision (-1 = not found); whole cache is
+// dropped when user records or rules have changed
+static int
+acl_cache_get(struct acl_cache *c, const char *k, size_t sz, uint64_t now)
+{
+    if (c->gen != usr_gen) {
+        acl_cache_clear(c);
+        c->gen = usr_gen;
+        return -1;
+    }
+    struct acl_cache_e *e = NULL;
+    HASH_FIND(hh, c->tbl, k, sz, e);
+    if (e == NULL) {
+        return -1;
+    }
+    // expired
+    if (now >= e->exp) {
+        HASH_DEL(c->tbl, e);
+        free(e);
+        return -1;
+    }
+    return e->res;
+}
+
+static void
+acl_cache_put(struct acl_cache *c, const char *k, size_t sz, int res, uint64_t now)
+{
+    // size limit reached, evict oldest
+    if (HASH_COUNT(c->tbl) >= c->max && c->tbl != NULL) {
+        struct acl_cache_e *o = c->tbl;
+        HASH_DEL(c->tbl, o);
+        free(o);
+    }
+    struct acl_cache_e *e = malloc(sizeof(struct acl_cache_e) + sz);
+    if (e == NULL) {
+        return;
+    }
+    memcpy(e->key, k, sz);
+    e->res = res;
+    e->exp = now + c->ttl;
+    HASH_ADD(hh, c->tbl, key, sz, e);
+}
+
+/********************/
+/* Client ctx utils */
+/********************/
+static void
+client_ctx_free(struct client_ctx *c)
+{
+    free(c->usr);
+    free(c->clid);
+    free(c);
+}
+
+static void
+client_ctx_clear()
+{
+    struct client_ctx *c, *tmp;
+    HASH_ITER(hh, clients, c, tmp)
+    {
+        HASH_DEL(clients, c);
+        client_ctx_free(c);
+    }
+}
+
+// resolve user record (user snapshot or db)
+static void
+client_ctx_resolve(struct client_ctx *c)
+{
+    c->id = -1;
+    c->flags = 0;
+    // user snapshot (might bump generation)
+    struct usr_snap *s = (snap_enabled ? usr_snap_get() : NULL);
+    c->gen = usr_gen;
+    if (s != NULL) {
+        struct usr_snap_e *e = NULL;
+        HASH_FIND_STR(s->tbl, c->usr, e);
+        if (e != NULL) {
+            c->id = e->id;
+            c->flags = e->flags;
+        }
+        return;
     }
     // find user in db
     umdb_uauth_d_t uauth;
-    if (!umdb_mngr_uauth(dbm, &uauth, username, password)) {
-        // not found
-        if (uauth.auth != 1) {
-            return MOSQ_ERR_AUTH;
-        }
+    if (!umdb_mngr_uget(dbm, &uauth, c->usr)) {
+        c->id = uauth.id;
+        c->flags = uauth.flags;
 
     } else {
         mosquitto_log_printf(MOSQ_LOG_ERR, "plg_mosquitto_auth: cannot authenicate user");
-        return MOSQ_ERR_AUTH;
+        // db errors are not cached, retry on next event
+        c->gen = usr_gen - 1;
     }
+}
 
-    // authenticated
-    return MOSQ_ERR_SUCCESS;
+// create (or replace) client context
+static struct client_ctx *
+client_ctx_new(const struct mosquitto *client, const char *usr)
+{
+    struct client_ctx *c = NULL;
+    HASH_FIND_PTR(clients, &client, c);
+    if (c != NULL) {
+        HASH_DEL(clients, c);
+        client_ctx_free(c);
+    }
+    c = calloc(1, sizeof(struct client_ctx));
+    if (c == NULL) {
+        return NULL;
+    }
+    const char *clid = mosquitto_client_id(client);
+    c->client = client;
+    c->usr = strdup(usr);
+    c->clid = (clid != NULL ? strdup(clid) : NULL);
+    if (c->usr == NULL || (clid != NULL && c->clid == NULL)) {
+        client_ctx_free(c);
+        return NULL;
+    }
+    client_ctx_resolve(c);
+    HASH_ADD_PTR(clients, client, c);
+    return c;
 }
 
-// Called by the broker when topic access must be checked. access will be one
-// of: MOSQ_ACL_SUBSCRIBE when a client is asking to subscribe to a topic
-// string.  This differs from MOSQ_ACL_READ in that it allows you to deny
-// access to topic strings rather than by pattern.  For example, you may use
-// MOSQ_ACL_SUBSCRIBE to deny subscriptions to ‘#’, but allow all topics in
-// MOSQ_ACL_READ.  This allows clients to subscribe to any topic they want, but
-// not discover what topics are in use on the server.  MOSQ_ACL_READ when a
-// message is about to be sent to a client (i.e. whether it can read that topic
-// or not).  MOSQ_ACL_WRITE when a message has been received from a client
-// (i.e. whether it can write to that topic or not).
-int
-mosquitto_auth_acl_check(void *user_data,
-                         int access,
-                         struct mosquitto *client,
-                         const struct mosquitto_acl_msg *msg)
+// get client context (created if client was
+// authenticated elsewhere, re-resolved if stale)
+static struct client_ctx *
+client_ctx_get(const struct mosquitto *client)
+{
+    struct client_ctx *c = NULL;
+    HASH_FIND_PTR(clients, &client, c);
+    if (c == NULL) {
+        const char *usr = mosquitto_client_username(client);
+        // anonymous not allowed
+        if (usr == NULL) {
+            return NULL;
+        }
+        return client_ctx_new(client, usr);
+    }
+    if (c->gen != usr_gen) {
+        client_ctx_resolve(c);
+    }
+    return c;
+}
+
+static void
+client_ctx_del(const struct mosquitto *client)
 {
-    // get username for client
-    const char *username = mosquitto_client_username(client);
+    struct client_ctx *c = NULL;
+    HASH_FIND_PTR(clients, &client, c);
+    if (c != NULL) {
+        HASH_DEL(clients, c);
+        client_ctx_free(c);
+    }
+}
+
+/*******************/
+/* Event callbacks */
+/*******************/
+// Called by the broker when a username/password must be checked
+// (MOSQ_EVT_BASIC_AUTH). Resolved user record is attached to the
+// client and reused for all subsequent ACL checks.
+static int
+plg_basic_auth(int event, void *event_data, void *userdata)
+{
+    struct mosquitto_evt_basic_auth *ed = event_data;
+    // previous context (client pointer reused)
+    client_ctx_del(ed->client);
     // anonymous not allowed
-    if (username == NULL) {
+    if (ed->username == NULL || ed->password == NULL) {
         return MOSQ_ERR_AUTH;
     }
-    // find user in db
-    umdb_uauth_d_t uauth;
-    if (!umdb_mngr_uget(dbm, &uauth, username)) {
-        // not found
-        if (uauth.id < 1) {
+    // user snapshot (lock-free)
+    struct usr_snap *s = (snap_enabled ? usr_snap_get() : NULL);
+    if (s != NULL) {
+        struct usr_snap_e *e = NULL;
+        HASH_FIND_STR(s->tbl, ed->username, e);
+        if (e == NULL ||
+            cred_verify(ed->username, e->pwd, ed->password, &cred_cache) != 1) {
             return MOSQ_ERR_AUTH;
         }
-        // "admin" topic requested, check user flags
-        if (strncmp(msg->topic, "mink/admin/", 11) == 0 && uauth.flags != 1) {
+
+        // find user in db
+    } else {
+        umdb_uauth_d_t uauth;
+        if (umdb_mngr_uauth(dbm, &uauth, ed->username, ed->password)) {
+            mosquitto_log_printf(MOSQ_LOG_ERR,
+                                 "plg_mosquitto_auth: cannot authenicate user");
+            return MOSQ_ERR_AUTH;
+        }
+        // not found
+        if (uauth.auth != 1) {
             return MOSQ_ERR_AUTH;
         }
+    }
 
-    } else {
-        mosquitto_log_printf(MOSQ_LOG_ERR, "plg_mosquitto_auth: cannot authenicate user");
+    // authenticated, attach user record
+    if (client_ctx_new(ed->client, ed->username) == NULL) {
+        return MOSQ_ERR_NOMEM;
+    }
+    return MOSQ_ERR_SUCCESS;
+}
+
+// Called by the broker when topic access must be checked
+// (MOSQ_EVT_ACL_CHECK). access will be one of:
+// MOSQ_ACL_SUBSCRIBE when a client is asking to subscribe to a topic
+// string, MOSQ_ACL_UNSUBSCRIBE when a client is unsubscribing,
+// MOSQ_ACL_READ when a message is about to be sent to a client and
+// MOSQ_ACL_WRITE when a message has been received from a client.
+static int
+plg_acl_check(int event, void *event_data, void *userdata)
+{
+    struct mosquitto_evt_acl_check *ed = event_data;
+    uint64_t now = plg_now();
+    // db mode, check for user/rule changes (rate limited)
+    struct usr_snap *s = (snap_enabled ? usr_snap_get() : NULL);
+    if (s == NULL) {
+        db_check_version(now);
+    }
+    // resolved user record
+    struct client_ctx *c = client_ctx_get(ed->client);
+    if (c == NULL) {
+        return MOSQ_ERR_ACL_DENIED;
+    }
+    // unsubscribe is always allowed for known users
+    if (ed->access == MOSQ_ACL_UNSUBSCRIBE) {
+        return (c->id < 1 ? MOSQ_ERR_ACL_DENIED : MOSQ_ERR_SUCCESS);
+    }
+    // cached decision (only for resolved user records,
+    // db errors are retried)
+    char b_s[256];
+    char *k = NULL;
+    size_t k_sz = 0;
+    if (acl_cache.ttl > 0 && c->gen == usr_gen) {
+        k = acl_cache_key(ed->access,
+                          c->usr,
+                          c->clid,
+                          ed->topic,
+                          b_s,
+                          sizeof(b_s),
+                          &k_sz);
+    }
+    int res = (k != NULL ? acl_cache_get(&acl_cache, k, k_sz, now) : -1);
+    if (res == -1) {
+        res = acl_decide((s != NULL ? s->acl : acl_db),
+                         c->usr,
+                         c->clid,
+                         c->id,
+                         c->flags,
+                         ed->access,
+                         ed->topic);
+        if (k != NULL) {
+            acl_cache_put(&acl_cache, k, k_sz, res, now);
+        }
+    }
+    if (k != b_s) {
+        free(k);
+    }
+    return res;
+}
+
+// Called by the broker when a client disconnects (MOSQ_EVT_DISCONNECT)
+static int
+plg_disconnect(int event, void *event_data, void *userdata)
+{
+    struct mosquitto_evt_disconnect *ed = event_data;
+    client_ctx_del(ed->client);
+    return MOSQ_ERR_SUCCESS;
+}
+
+// Called by the broker when it is requested to reload its
+// configuration whilst running (MOSQ_EVT_RELOAD)
+static int
+plg_reload(int event, void *event_data, void *userdata)
+{
+    // recompile rules (previous rules are kept on error)
+    acl_db_reload();
+    // reload user snapshot (older pending
+    // snapshot is discarded)
+    if (snap_enabled) {
+        struct usr_snap *s = usr_snap_load();
+        if (s != NULL) {
+            usr_snap_publish(NULL);
+            usr_snap_free(snap_cur);
+            snap_cur = s;
+        }
+    }
+    // re-resolve all clients (also drops
+    // cached ACL decisions)
+    usr_gen++;
+    return MOSQ_ERR_SUCCESS;
+}
+
+/*****************/
+/* Plugin events */
+/*****************/
+static const struct {
+    int event;
+    MOSQ_FUNC_generic_callback cb;
+} PLG_EVENTS[] = { { MOSQ_EVT_BASIC_AUTH, &plg_basic_auth },
+                   { MOSQ_EVT_ACL_CHECK, &plg_acl_check },
+                   { MOSQ_EVT_DISCONNECT, &plg_disconnect },
+                   { MOSQ_EVT_RELOAD, &plg_reload } };
+
+#define PLG_EVENTS_NUM (sizeof(PLG_EVENTS) / sizeof(PLG_EVENTS[0]))
+
+// plugin version 5 (event callbacks)
+int
+mosquitto_plugin_version(int supported_version_count, const int *supported_versions)
+{
+    for (int i = 0; i < supported_version_count; i++) {
+        if (supported_versions[i] == MOSQ_PLUGIN_VERSION) {
+            return MOSQ_PLUGIN_VERSION;
+        }
+    }
+    return -1;
+}
+
+// Called after the plugin has been loaded and mosquitto_plugin_version
+// has been called.  This will only ever be called once and can be used to
+// initialise the plugin.
+int
+mosquitto_plugin_init(mosquitto_plugin_id_t *identifier,
+                      void **user_data,
+                      struct mosquitto_opt *opts,
+                      int opt_count)
+{
+    plg_id = identifier;
+    // process options
+    for (int i = 0; i < opt_count; i++) {
+        if (strncmp(opts[i].key, "db_name", 7) == 0) {
+            db_name = opts[i].value;
+
+            // verified credential cache ttl (seconds, 0 = disabled)
+        } else if (strcmp(opts[i].key, "cred_cache_ttl") == 0) {
+            cred_cache.ttl = strtoull(opts[i].value, NULL, 10) * 1000;
+
+            // verified credential cache size
+        } else if (strcmp(opts[i].key, "cred_cache_size") == 0) {
+            cred_cache.max = strtoull(opts[i].value, NULL, 10);
+            if (cred_cache.max == 0) {
+                cred_cache.ttl = 0;
+            }
+
+            // ACL decision cache ttl (seconds, 0 = disabled)
+        } else if (strcmp(opts[i].key, "acl_cache_ttl") == 0) {
+            acl_cache.ttl = strtoull(opts[i].value, NULL, 10) * 1000;
+
+            // ACL decision cache size
+        } else if (strcmp(opts[i].key, "acl_cache_size") == 0) {
+            acl_cache.max = strtoull(opts[i].value, NULL, 10);
+            if (acl_cache.max == 0) {
+                acl_cache.ttl = 0;
+            }
+
+            // in-memory user snapshot (default = enabled)
+        } else if (strcmp(opts[i].key, "user_snapshot") == 0) {
+            snap_enabled = !(strcmp(opts[i].value, "false") == 0 ||
+                             strcmp(opts[i].value, "0") == 0);
+        }
+    }
+    // missing db options
+    if (db_name == NULL) {
+        mosquitto_log_printf(MOSQ_LOG_ERR,
+                             "plg_mosquitto_auth: db_name option is missing");
+        return MOSQ_ERR_AUTH;
+    }
+    // schema migration (db might be read-only
+    // for broker, not fatal)
+    if (umdb_migrate(db_name)) {
+        mosquitto_log_printf(MOSQ_LOG_WARNING,
+                             "plg_mosquitto_auth: cannot migrate db schema");
+    }
+    // create umdbm and connect
+    dbm = umdb_mngr_new(db_name);
+    if (dbm == NULL) {
+        mosquitto_log_printf(MOSQ_LOG_ERR, "plg_mosquitto_auth: error while connecting");
         return MOSQ_ERR_AUTH;
     }
+    // credential cache key (disable cache on error)
+    if (RAND_bytes(cred_cache.secret, sizeof(cred_cache.secret)) != 1) {
+        cred_cache.ttl = 0;
+    }
+    umdb_mngr_set_verify(dbm, &cred_verify, &cred_cache);
+    // ACL rules (compiled) and db version; if
+    // rules cannot be loaded, deny until reloaded
+    if (acl_db_reload()) {
+        acl_db = acl_rules_new();
+        if (acl_db == NULL) {
+            return MOSQ_ERR_NOMEM;
+        }
+    }
+    db_check_version(plg_now());
+    // load user snapshot and watch for db changes
+    if (snap_enabled) {
+        snap_cur = usr_snap_load();
+        if (snap_cur == NULL) {
+            mosquitto_log_printf(MOSQ_LOG_ERR,
+                                 "plg_mosquitto_auth: cannot load user snapshot, using db");
+            snap_enabled = false;
+
+        } else {
+            snap_th_running = 1;
+            if (pthread_create(&snap_th, NULL, &usr_snap_watch, NULL)) {
+                mosquitto_log_printf(MOSQ_LOG_ERR,
+                                     "plg_mosquitto_auth: cannot start db watcher");
+                snap_th_running = 0;
+            } else {
+                snap_th_created = true;
+            }
+        }
+    }
+    // register event callbacks
+    for (int i = 0; i < PLG_EVENTS_NUM; i++) {
+        if (mosquitto_callback_register(plg_id,
+                                        PLG_EVENTS[i].event,
+                                        PLG_EVENTS[i].cb,
+                                        NULL,
+                                        NULL) != MOSQ_ERR_SUCCESS) {
+            mosquitto_log_printf(MOSQ_LOG_ERR,
+                                 "plg_mosquitto_auth: cannot register event callback");
+            return MOSQ_ERR_UNKNOWN;
+        }
+    }
 
-    // authenticated
+    // plugin initialised
     return MOSQ_ERR_SUCCESS;
 }
 
+// Called when the broker is shutting down.  This will only ever be called once
+// per plugin.
+int
+mosquitto_plugin_cleanup(void *userdata, struct mosquitto_opt *options, int option_count)
+{
+    // unregister event callbacks
+    for (int i = 0; i < PLG_EVENTS_NUM; i++) {
+        mosquitto_callback_unregister(plg_id, PLG_EVENTS[i].event, PLG_EVENTS[i].cb, NULL);
+    }
+    // stop db watcher (might have already exited)
+    UM_ATOMIC_COMP_SWAP(&snap_th_running, 1, 0);
+    if (snap_th_created) {
+        pthread_join(snap_th, NULL);
+        snap_th_created = false;
+    }
+    usr_snap_free(UM_ATOMIC_COMP_SWAP(&snap_pend, NULL, NULL));
+    snap_pend = NULL;
+    usr_snap_free(snap_cur);
+    snap_cur = NULL;
+    client_ctx_clear();
+    cred_cache_clear(&cred_cache);
+    acl_cache_clear(&acl_cache);
+    acl_rules_free(acl_db);
+    acl_db = NULL;
+    acl_db_ok = false;
+    umdb_mngr_free(dbm);
+    dbm = NULL;
+    return MOSQ_ERR_SUCCESS;
+}
@@ -0,0 +1,89 @@
+/*
+ *               _____  ____ __
+ *   __ ____ _  /  _/ |/ / //_/
+ *  / // /  ' \_/ //    / ,<
+ *  \_,_/_/_/_/___/_/|_/_/|_|
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <openssl/crypto.h>
+#include <umdb.h>
+
+// help
+static void
+print_help()
+{
+    printf("%s\n\nOptions:\n", "umink-passwd - add/update Mosquitto Auth user");
+    printf(" %s\n %s\n %s\n %s\n\n",
+           "-?    help",
+           "-d    user database",
+           "-u    username",
+           "-f    user flags (default 0)");
+    printf("%s\n", "Password is read from stdin (first line) and stored hashed.");
+}
+
+// main
+int
+main(int argc, char **argv)
+{
+    const char *db = NULL;
+    const char *u = NULL;
+    int flags = 0;
+    int opt;
+
+    // get args
+    while ((opt = getopt(argc, argv, "?d:u:f:")) != -1) {
+        switch (opt) {
+        // user database
+        case 'd':
+            db = optarg;
+            break;
+
+        // username
+        case 'u':
+            u = optarg;
+            break;
+
+        // user flags
+        case 'f':
+            flags = atoi(optarg);
+            break;
+
+        default:
+            print_help();
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (db == NULL || u == NULL) {
+        print_help();
+        exit(EXIT_FAILURE);
+    }
+
+    // password (not passed as argument,
+    // visible in process list)
+    char p[256];
+    if (fgets(p, sizeof(p), stdin) == NULL) {
+        printf("%s\n", "ERROR: Password missing");
+        exit(EXIT_FAILURE);
+    }
+    p[strcspn(p, "\r\n")] = '\0';
+    if (p[0] == '\0') {
+        printf("%s\n", "ERROR: Password missing");
+        exit(EXIT_FAILURE);
+    }
+
+    // store hashed credential
+    int r = umdb_user_add(db, u, p, flags);
+    OPENSSL_cleanse(p, sizeof(p));
+    if (r) {
+        printf("ERROR: Cannot add user [%s] (%d)\n", u, r);
+        exit(EXIT_FAILURE);
+    }
+    return 0;
+}
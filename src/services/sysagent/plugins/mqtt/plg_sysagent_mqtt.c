@@ -11,6 +11,7 @@
 #include <umink_pkg_config.h>
 #include <umink_plugin.h>
 #include <umatomic.h>
+#include <umtopic.h>
 #include <stdio.h>
 #include <pthread.h>
 #include <string.h>
@@ -34,8 +35,51 @@ int COMMANDS[] = { CMD_MQTT_PUBLISH,
                    // end of list marker
                    -1 };
 
+/*******************/
+/* plugin features */
+/*******************/
+uint32_t FEATURES = UMPLG_FEAT_STDD_ZC;
+
 static const char *SIG_MQTT_RX = "mqtt:RX";
 
+// distinct signals per message (tracked on stack)
+#define MQTT_RX_SIG_MAX 16
+
+/***************************/
+/* MQTT subscription route */
+/***************************/
+struct mqtt_sub {
+    // topic filter
+    char *topic;
+    // signal name
+    char *signal;
+    // subscription QoS
+    int qos;
+};
+
+static void
+mqtt_sub_copy(void *_dst, const void *_src)
+{
+    struct mqtt_sub *dst = _dst;
+    const struct mqtt_sub *src = _src;
+    dst->topic = strdup(src->topic);
+    dst->signal = strdup(src->signal);
+    dst->qos = src->qos;
+}
+
+static void
+mqtt_sub_dtor(void *_elt)
+{
+    struct mqtt_sub *elt = _elt;
+    free(elt->topic);
+    free(elt->signal);
+}
+
+static const UT_icd mqtt_sub_icd = { sizeof(struct mqtt_sub),
+                                     NULL,
+                                     &mqtt_sub_copy,
+                                     &mqtt_sub_dtor };
+
 /******************************/
 /* MQTT connection descriptor */
 /******************************/
@@ -46,12 +90,32 @@ struct mqtt_conn_d {
     MQTTAsync client;
     // plugin manager pointer
     umplg_mngr_t *pm;
-    // mqtt topics
+    // mqtt subscriptions
     UT_array *topics;
+    // topic filter -> signal routes
+    umtopic_trie_t *routes;
+    // default publish QoS
+    int qos;
+    // max in-flight QoS1/2 messages (0 = client default)
+    int max_inflight;
     // hashable
     UT_hash_handle hh;
 };
 
+// rx routing context
+struct mqtt_rx_ctx {
+    // connection
+    struct mqtt_conn_d *conn;
+    // signal input data
+    umplg_data_std_t *d;
+    // signals already processed (stack
+    // buffer first, heap if exceeded)
+    const char **sigs;
+    size_t sigs_n;
+    size_t sigs_cap;
+    const char *sigs_buf[MQTT_RX_SIG_MAX];
+};
+
 /***************************/
 /* MQTT connection manager */
 /***************************/
@@ -63,7 +127,7 @@ struct mqtt_conn_mngr {
 };
 
 // fwd declarations
-static int mqtt_conn_sub(struct mqtt_conn_d *conn, const char *t);
+static int mqtt_conn_sub(struct mqtt_conn_d *conn, const char *t, int qos);
 static int mqtt_conn_connect(struct mqtt_conn_d *conn, struct json_object *j_conn);
 
 // globals
@@ -75,37 +139,74 @@ mqtt_conn_new(umplg_mngr_t *pm)
     struct mqtt_conn_d *c = malloc(sizeof(struct mqtt_conn_d));
     c->pm = pm;
     c->client = NULL;
-    utarray_new(c->topics, &ut_str_icd);
+    utarray_new(c->topics, &mqtt_sub_icd);
+    c->routes = umtopic_new();
+    c->qos = 1;
+    c->max_inflight = 0;
     return c;
 }
 
+static void
+mqtt_on_route(void *val, void *arg)
+{
+    struct mqtt_rx_ctx *ctx = arg;
+    const char *sig = val;
+    // deliver once per signal (overlapping filters)
+    for (size_t i = 0; i < ctx->sigs_n; i++) {
+        if (strcmp(ctx->sigs[i], sig) == 0) {
+            return;
+        }
+    }
+    if (ctx->sigs_n == ctx->sigs_cap) {
+        size_t cap = ctx->sigs_cap * 2;
+        const char **sigs = (ctx->sigs == ctx->sigs_buf ?
+                                 malloc(cap * sizeof(const char *)) :
+                                 realloc(ctx->sigs, cap * sizeof(const char *)));
+        if (sigs == NULL) {
+            umd_log(UMD,
+                    UMD_LLT_ERROR,
+                    "plg_mqtt: [cannot track signal [%s], duplicates possible]",
+                    sig);
+        } else {
+            if (ctx->sigs == ctx->sigs_buf) {
+                memcpy(sigs, ctx->sigs_buf, sizeof(ctx->sigs_buf));
+            }
+            ctx->sigs = sigs;
+            ctx->sigs_cap = cap;
+        }
+    }
+    if (ctx->sigs_n < ctx->sigs_cap) {
+        ctx->sigs[ctx->sigs_n++] = sig;
+    }
+    // process signal (async, if enabled)
+    umplg_proc_signal_async(ctx->conn->pm, sig, ctx->d);
+}
+
 static int
 mqtt_on_rx(void *ctx, char *t, int t_sz, MQTTAsync_message *msg)
 {
     // context
     struct mqtt_conn_d *conn = ctx;
-    // msg data
-    char s[msg->payloadlen + 1];
-    memcpy(s, msg->payload, msg->payloadlen);
-    s[msg->payloadlen] = '\0';
-    // data
+    // topic length (0 if NUL terminated)
+    size_t t_l = (t_sz > 0 ? t_sz : strlen(t));
+    // signal input data (zero-copy, stack arena)
+    char arena[256];
     umplg_data_std_t e_d = { .items = NULL };
-    umplg_data_std_items_t items = { .table = NULL };
-    umplg_data_std_item_t item_topic = { .name = "mqtt_topic", .value = t };
-    umplg_data_std_item_t item_pld = { .name = "mqtt_payload", .value = s };
-    // create signal input data
-    umplg_stdd_init(&e_d);
-    umplg_stdd_item_add(&items, &item_topic);
-    umplg_stdd_item_add(&items, &item_pld);
-    umplg_stdd_items_add(&e_d, &items);
-
-    // output buffer
-    char *b = NULL;
-    size_t b_sz = 0;
-    // process signal
-    umplg_proc_signal(conn->pm, SIG_MQTT_RX, &e_d, &b, &b_sz);
+    umplg_stdd_init_buf(&e_d, arena, sizeof(arena));
+    umplg_stdd_row_t *row = umplg_stdd_row_new(&e_d, 2);
+    umplg_stdd_col_add(&e_d, row, "mqtt_topic", t, t_l);
+    umplg_stdd_col_add_blob(&e_d, row, "mqtt_payload", msg->payload, msg->payloadlen);
+
+    // route to signals of matching subscriptions
+    struct mqtt_rx_ctx rx = { .conn = conn, .d = &e_d, .sigs_cap = MQTT_RX_SIG_MAX };
+    rx.sigs = rx.sigs_buf;
+    umtopic_match(conn->routes, t, t_l, &mqtt_on_route, &rx);
+    if (rx.sigs != rx.sigs_buf) {
+        free(rx.sigs);
+    }
 
     // cleanup
+    umplg_stdd_free(&e_d);
     MQTTAsync_freeMessage(&msg);
     MQTTAsync_free(t);
     return 1;
@@ -117,9 +218,9 @@ mqtt_on_connect(void *context, char *cause)
     // context
     struct mqtt_conn_d *conn = context;
     // get topics
-    char **t = NULL;
-    while ((t = (char **)utarray_next(conn->topics, t))) {
-        mqtt_conn_sub(conn, *t);
+    struct mqtt_sub *t = NULL;
+    while ((t = utarray_next(conn->topics, t))) {
+        mqtt_conn_sub(conn, t->topic, t->qos);
     }
 }
 
@@ -160,6 +261,10 @@ mqtt_conn_connect(struct mqtt_conn_d *conn, struct json_object *j_conn)
     conn_opts.username = json_object_get_string(j_usr);
     conn_opts.password = json_object_get_string(j_pwd);
     conn_opts.ssl = &ssl_opts;
+    // in-flight window (QoS1/2 pipelining)
+    if (conn->max_inflight > 0) {
+        conn_opts.maxInflight = conn->max_inflight;
+    }
 
     // connect
     if (MQTTAsync_connect(conn->client, &conn_opts) != MQTTASYNC_SUCCESS) {
@@ -177,22 +282,25 @@ mqtt_conn_pub(struct mqtt_conn_d *conn,
               const char *d,
               size_t d_sz,
               const char *t,
+              int qos,
               bool retain)
 {
     // sanity check
     if (conn->client == NULL) {
         return 1;
     }
-    // setup mqtt payload
-    MQTTAsync_message pubmsg = MQTTAsync_message_initializer;
+    // QoS0 (fire and forget, no response tracking)
+    if (qos == 0) {
+        if (MQTTAsync_send(conn->client, t, d_sz, d, 0, retain, NULL) != MQTTASYNC_SUCCESS) {
+            // error
+            return 1;
+        }
+        return 0;
+    }
+    // QoS1/2
     MQTTAsync_responseOptions opts = MQTTAsync_responseOptions_initializer;
     opts.context = conn;
-    pubmsg.payload = (void *)d;
-    pubmsg.payloadlen = d_sz;
-    pubmsg.qos = 1;
-    pubmsg.retained = retain;
-    // send
-    if (MQTTAsync_sendMessage(conn->client, t, &pubmsg, &opts) != MQTTASYNC_SUCCESS) {
+    if (MQTTAsync_send(conn->client, t, d_sz, d, qos, retain, &opts) != MQTTASYNC_SUCCESS) {
         // error
         return 1;
     }
@@ -201,14 +309,14 @@ mqtt_conn_pub(struct mqtt_conn_d *conn,
 }
 
 static int
-mqtt_conn_sub(struct mqtt_conn_d *conn, const char *t)
+mqtt_conn_sub(struct mqtt_conn_d *conn, const char *t, int qos)
 {
     // sanity check
     if (conn->client == NULL) {
         return 1;
     }
     MQTTAsync_responseOptions opts = MQTTAsync_responseOptions_initializer;
-    if (MQTTAsync_subscribe(conn->client, t, 1, &opts) != MQTTASYNC_SUCCESS) {
+    if (MQTTAsync_subscribe(conn->client, t, qos, &opts) != MQTTASYNC_SUCCESS) {
         // error
         return 1;
     }
@@ -216,10 +324,23 @@ mqtt_conn_sub(struct mqtt_conn_d *conn, const char *t)
     return 0;
 }
 
-static void
-mqtt_conn_add_topic(struct mqtt_conn_d *conn, const char *t)
+static int
+mqtt_conn_add_topic(struct mqtt_conn_d *conn, const char *t, const char *sig, int qos)
 {
-    utarray_push_back(conn->topics, &t);
+    // validate topic filter and QoS
+    if (!umtopic_filter_valid(t) || qos < 0 || qos > 2) {
+        return 1;
+    }
+    struct mqtt_sub sub = { (char *)t, (char *)sig, qos };
+    utarray_push_back(conn->topics, &sub);
+    // route (signal name owned by subscription)
+    struct mqtt_sub *n_sub = utarray_back(conn->topics);
+    if (umtopic_add(conn->routes, n_sub->topic, n_sub->signal)) {
+        // no subscription without route
+        utarray_pop_back(conn->topics);
+        return 2;
+    }
+    return 0;
 }
 
 static struct mqtt_conn_mngr *
@@ -290,6 +411,7 @@ mqtt_mngr_del_conn(struct mqtt_conn_mngr *m, const char *name, bool th_safe)
         HASH_DEL(m->conns, tmp_conn);
         MQTTAsync_destroy(&tmp_conn->client);
         free(tmp_conn->name);
+        umtopic_free(tmp_conn->routes);
         utarray_free(tmp_conn->topics);
         free(tmp_conn);
     }
@@ -312,12 +434,12 @@ mqtt_mngr_free(struct mqtt_conn_mngr *m){
 }
 
 static struct mqtt_conn_d *
-mqtt_mngr_get_conn(struct mqtt_conn_mngr *m, const char *name)
+mqtt_mngr_get_conn(struct mqtt_conn_mngr *m, const char *name, size_t sz)
 {
     struct mqtt_conn_d *tmp_conn = NULL;
     // lock
     pthread_mutex_lock(&m->mtx);
-    HASH_FIND_STR(m->conns, name, tmp_conn);
+    HASH_FIND(hh, m->conns, name, sz, tmp_conn);
     // unlock
     pthread_mutex_unlock(&m->mtx);
     return tmp_conn;
@@ -392,6 +514,18 @@ process_cfg(umplg_mngr_t *pm, struct mqtt_conn_mngr *mngr)
             if (!conn) {
                 continue;
             }
+            // default publish QoS and in-flight window (optional)
+            struct json_object *j_qos = json_object_object_get(j_conn, "qos");
+            struct json_object *j_mif = json_object_object_get(j_conn, "max_inflight");
+            if (j_qos != NULL && json_object_is_type(j_qos, json_type_int)) {
+                int qos = json_object_get_int(j_qos);
+                if (qos >= 0 && qos <= 2) {
+                    conn->qos = qos;
+                }
+            }
+            if (j_mif != NULL && json_object_is_type(j_mif, json_type_int)) {
+                conn->max_inflight = json_object_get_int(j_mif);
+            }
             // subscribe to topics
             struct json_object *j_sub = json_object_object_get(j_conn, "subscriptions");
             if (j_sub != NULL && json_object_is_type(j_sub, json_type_array)) {
@@ -399,11 +533,38 @@ process_cfg(umplg_mngr_t *pm, struct mqtt_conn_mngr *mngr)
                 for (int i = 0; i < sub_l; ++i) {
                     // get array object (v declared in json_object_object_foreach macro)
                     v = json_object_array_get_idx(j_sub, i);
-                    // verify type
-                    if (!json_object_is_type(v, json_type_string)) {
+                    const char *t = NULL;
+                    const char *sig = SIG_MQTT_RX;
+                    int qos = 1;
+                    // topic only (default signal)
+                    if (json_object_is_type(v, json_type_string)) {
+                        t = json_object_get_string(v);
+
+                        // topic and signal
+                    } else if (json_object_is_type(v, json_type_object)) {
+                        struct json_object *j_t = json_object_object_get(v, "topic");
+                        struct json_object *j_s = json_object_object_get(v, "signal");
+                        struct json_object *j_q = json_object_object_get(v, "qos");
+                        if (j_t == NULL || !json_object_is_type(j_t, json_type_string)) {
+                            continue;
+                        }
+                        t = json_object_get_string(j_t);
+                        if (j_s != NULL && json_object_is_type(j_s, json_type_string)) {
+                            sig = json_object_get_string(j_s);
+                        }
+                        if (j_q != NULL && json_object_is_type(j_q, json_type_int)) {
+                            qos = json_object_get_int(j_q);
+                        }
+
+                    } else {
                         continue;
                     }
-                    mqtt_conn_add_topic(conn, json_object_get_string(v));
+                    if (mqtt_conn_add_topic(conn, t, sig, qos)) {
+                        umd_log(UMD,
+                                UMD_LLT_ERROR,
+                                "plg_mqtt: [invalid subscription [%s]]",
+                                t);
+                    }
                 }
             }
             umd_log(UMD, UMD_LLT_INFO, "plg_mqtt: [adding connection [%s]", conn->name);
@@ -445,45 +606,77 @@ static void
 impl_mqtt_publish(umplg_data_std_t *data)
 {
     // sanity check
-    if (data == NULL || utarray_len(data->items) < 3) {
+    if (data == NULL || umplg_stdd_rows(data) < 3) {
         umd_log(UMD, UMD_LLT_ERROR, "plg_mqtt: [CMD_MQTT_PUBLISH invalid data]");
         return;
     }
-    // items elem at index
-    umplg_data_std_items_t *row = utarray_eltptr(data->items, 0);
-    // sanity check (columns)
-    if (HASH_COUNT(row->table) < 1) {
+    // connection name (first column)
+    umplg_stdd_col_t c_conn;
+    if (umplg_stdd_col_get(data, 0, 0, &c_conn)) {
         return;
     }
-    // get first column
-    umplg_data_std_item_t *column = row->table;
 
-    // get connection
-    struct mqtt_conn_d *c = mqtt_mngr_get_conn(mqtt_mngr, column->value);
+    // get connection (length-aware)
+    char n_buf[32];
+    const char *n = umplg_stdd_col_str(&c_conn, n_buf, sizeof(n_buf));
+    size_t n_sz = (n == n_buf ? strlen(n) : c_conn.sz);
+    struct mqtt_conn_d *c = mqtt_mngr_get_conn(mqtt_mngr, n, n_sz);
     if (c == NULL) {
         return;
     }
-    // mqtt data
-    row = utarray_eltptr(data->items, 2);
-    umplg_data_std_item_t *mqtt_data = row->table;
-    // mqtt topic
-    row = utarray_eltptr(data->items, 1);
-    umplg_data_std_item_t *mqtt_topic = row->table;
+    // mqtt topic and data
+    umplg_stdd_col_t mqtt_topic;
+    umplg_stdd_col_t mqtt_data;
+    if (umplg_stdd_col_get(data, 1, 0, &mqtt_topic) ||
+        umplg_stdd_col_get(data, 2, 0, &mqtt_data)) {
+        return;
+    }
 
     // do not retain by default
     bool retain = false;
-    // check retain flag in input data
-    if (utarray_len(data->items) >= 4) {
-        row = utarray_eltptr(data->items, 3);
-        retain = atoi(row->table->value);
+    // check retain flag in input data (bool, number or string)
+    umplg_stdd_col_t c_retain;
+    if (umplg_stdd_col_get(data, 3, 0, &c_retain) == 0) {
+        retain = umplg_stdd_col_bool(&c_retain);
+    }
+    // QoS (optional, connection default)
+    int qos = c->qos;
+    umplg_stdd_col_t c_qos;
+    if (umplg_stdd_col_get(data, 4, 0, &c_qos) == 0) {
+        int64_t q = umplg_stdd_col_int(&c_qos);
+        if (q >= 0 && q <= 2) {
+            qos = q;
+        }
+    }
+    // payload is passed as is (binary safe),
+    // numeric data is formatted
+    char d_buf[32];
+    const char *d = umplg_stdd_col_str(&mqtt_data, d_buf, sizeof(d_buf));
+    size_t d_sz = (d == d_buf ? strlen(d) : mqtt_data.sz);
+
+    // topic must be NUL terminated (zero-copy
+    // values might not be)
+    char t_buf[256];
+    char *t = t_buf;
+    if (mqtt_topic.sz >= sizeof(t_buf)) {
+        t = malloc(mqtt_topic.sz + 1);
+        if (t == NULL) {
+            return;
+        }
+    }
+    const char *t_v = umplg_stdd_col_str(&mqtt_topic, t, sizeof(t_buf));
+    if (t_v != t) {
+        memcpy(t, t_v, mqtt_topic.sz);
+        t[mqtt_topic.sz] = '\0';
     }
 
     // publish
-    mqtt_conn_pub(c,
-                  mqtt_data->value,
-                  strlen(mqtt_data->value),
-                  mqtt_topic->value,
-                  retain);
+    mqtt_conn_pub(c, d, d_sz, t, qos, retain);
+
+    // cleanup
+    if (t != t_buf) {
+        free(t);
+    }
 }
 
 /*************************/
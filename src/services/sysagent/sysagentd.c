@@ -19,6 +19,10 @@
 #include <dirent.h>
 #include <json_tokener.h>
 
+// signal queue limits
+#define SIGQ_WORKERS_MAX 64
+#define SIGQ_DEPTH_MAX   65536
+
 // daemon name and description
 const char *UMD_TYPE = "umsysagent";
 const char *UMD_DESCRIPTION = "umINK System Agent";
@@ -46,7 +50,12 @@ print_help()
            "-p    plugin path",
            "-v    display version",
            "-D    start in debug mode");
-    printf("%s\n %s\n", "Plugins:", "--plugins-cfg    Plugins configuration file");
+    printf("%s\n %s\n\n", "Plugins:", "--plugins-cfg    Plugins configuration file");
+    printf("%s\n %s\n %s\n %s\n",
+           "Logging:",
+           "--log-file       Log to file (in addition to syslog)",
+           "--log-stdout     Log to stdout (in addition to syslog)",
+           "--log-ring       Log records buffered per thread (8 - 4096)");
 }
 
 // process args
@@ -56,7 +65,14 @@ proc_args(umdaemon_t *umd, int argc, char **argv)
     int opt;
     int option_index = 0;
     struct option long_options[] = { { "plugins-cfg", required_argument, 0, 0 },
+                                     { "log-file", required_argument, 0, 0 },
+                                     { "log-stdout", no_argument, 0, 0 },
+                                     { "log-ring", required_argument, 0, 0 },
                                      { 0, 0, 0, 0 } };
+    // log sinks
+    int log_sinks = UMD_LST_SYSLOG;
+    const char *log_file = NULL;
+    int log_ring = UMD_LOG_RING_SZ;
 
     // mandatory param count
     int mpc = 0;
@@ -76,6 +92,19 @@ proc_args(umdaemon_t *umd, int argc, char **argv)
                 dd->plg_cfg_f = optarg;
                 ++mpc;
                 break;
+            // log-file
+            case 1:
+                log_sinks |= UMD_LST_FILE;
+                log_file = optarg;
+                break;
+            // log-stdout
+            case 2:
+                log_sinks |= UMD_LST_STDOUT;
+                break;
+            // log-ring
+            case 3:
+                log_ring = atoi(optarg);
+                break;
             default:
                 break;
             }
@@ -119,6 +148,17 @@ proc_args(umdaemon_t *umd, int argc, char **argv)
         print_help();
         exit(EXIT_FAILURE);
     }
+
+    // log sinks
+    if (umd_set_log_sinks(umd, log_sinks, log_file) != 0) {
+        printf("ERROR: Cannot open log file [%s]\n", log_file);
+        exit(EXIT_FAILURE);
+    }
+    // log ring size
+    if (umd_set_log_ring(umd, log_ring) != 0) {
+        printf("ERROR: Invalid log ring size [%d]\n", log_ring);
+        exit(EXIT_FAILURE);
+    }
 }
 
 static char **
@@ -191,6 +231,64 @@ init_plugins(umplg_mngr_t *pm, const char *pdir)
     free(plg_fname);
 }
 
+static void
+init_sigq(umplg_mngr_t *pm, struct json_object *cfg)
+{
+    // async signal queue config (optional)
+    struct json_object *j_sq = json_object_object_get(cfg, "signal_queue");
+    if (j_sq == NULL || !json_object_is_type(j_sq, json_type_object)) {
+        return;
+    }
+    // defaults
+    umplg_sigq_cfg_t sq_cfg = { .workers = 1,
+                                .depth = 1024,
+                                .policy = UMPLG_SQ_BLOCK,
+                                .ordered = true };
+
+    struct json_object *j_v = json_object_object_get(j_sq, "workers");
+    if (j_v != NULL && json_object_is_type(j_v, json_type_int)) {
+        int64_t v = json_object_get_int64(j_v);
+        if (v < 1 || v > SIGQ_WORKERS_MAX) {
+            umd_log(UMD,
+                    UMD_LLT_WARNING,
+                    "sysagentd: [invalid number of signal queue workers (1 - %d)]",
+                    SIGQ_WORKERS_MAX);
+            v = (v < 1 ? 1 : SIGQ_WORKERS_MAX);
+        }
+        sq_cfg.workers = v;
+    }
+    j_v = json_object_object_get(j_sq, "depth");
+    if (j_v != NULL && json_object_is_type(j_v, json_type_int)) {
+        int64_t v = json_object_get_int64(j_v);
+        if (v < 1 || v > SIGQ_DEPTH_MAX) {
+            umd_log(UMD,
+                    UMD_LLT_WARNING,
+                    "sysagentd: [invalid signal queue depth (1 - %d)]",
+                    SIGQ_DEPTH_MAX);
+            v = (v < 1 ? 1 : SIGQ_DEPTH_MAX);
+        }
+        sq_cfg.depth = v;
+    }
+    j_v = json_object_object_get(j_sq, "ordered");
+    if (j_v != NULL && json_object_is_type(j_v, json_type_boolean)) {
+        sq_cfg.ordered = json_object_get_boolean(j_v);
+    }
+    j_v = json_object_object_get(j_sq, "overflow");
+    if (j_v != NULL && json_object_is_type(j_v, json_type_string)) {
+        const char *p = json_object_get_string(j_v);
+        if (strcmp(p, "drop_oldest") == 0) {
+            sq_cfg.policy = UMPLG_SQ_DROP_OLDEST;
+        } else if (strcmp(p, "drop_new") == 0) {
+            sq_cfg.policy = UMPLG_SQ_DROP_NEW;
+        }
+    }
+    // start workers
+    if (umplg_start_async(pm, &sq_cfg)) {
+        printf("%s\n", "ERROR: Invalid signal queue configuration");
+        exit(EXIT_FAILURE);
+    }
+}
+
 static void
 init(sysagentdd_t *dd)
 {
@@ -223,6 +321,9 @@ init(sysagentdd_t *dd)
     dd->pm->cfg = dd->cfg;
     free(b);
 
+    // async signal processing
+    init_sigq(dd->pm, dd->cfg);
+
     // init plugins
     init_plugins(dd->pm, dd->plg_pth);
 }
@@ -14,11 +14,71 @@
 #include <string.h>
 #include <signal.h>
 #include <syslog.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
 #include <umdaemon.h>
 #include <umatomic.h>
+#include <uthash.h>
+
+// flusher idle interval (ms)
+#define UMD_LOG_IDLE_MS 10
+// max events per loop iteration
+#define UMD_LOOP_EVENTS_MAX 64
+
+// log record
+struct umd_log_rec {
+    // log level
+    int level;
+    // timestamp (realtime)
+    struct timespec ts;
+    // formatted message
+    char msg[UMD_LOG_MSG_MAX];
+    // overflow (message longer than msg, heap
+    // allocated, freed by flusher)
+    char *ext;
+};
+
+// per-thread log ring (single producer, flusher
+// thread is the only consumer)
+struct umd_log_ring {
+    // ring size - 1 (power of 2)
+    uint32_t mask;
+    // producer/consumer positions (free running)
+    uint32_t head;
+    uint32_t tail;
+    // records dropped (ring full)
+    uint32_t dropped;
+    // owner thread exited (ring can be reused)
+    uint8_t orphan;
+    // next ring
+    struct umd_log_ring *next;
+    // records
+    struct umd_log_rec recs[];
+};
+
+// async logger
+struct umd_logger {
+    // rings (prepend only, freed with logger)
+    struct umd_log_ring *rings;
+    // ring owner thread exit detection
+    pthread_key_t key;
+    // flusher thread
+    pthread_t th;
+    uint8_t running;
+    // flusher wakeup (ring half full)
+    pthread_mutex_t mtx;
+    pthread_cond_t cnd;
+};
 
 // running UMD
 umdaemon_t *UMD = NULL;
+// current thread's log ring
+static __thread struct umd_log_ring *log_ring = NULL;
 
 umdaemon_t *
 umd_create(const char *id, const char *type)
@@ -41,8 +101,10 @@ umd_create(const char *id, const char *type)
         strcpy(&res->fqn[5 + l2], ".");
         strcpy(&res->fqn[6 + l2], id);
         res->fqn[l2 + l1 + 6] = 0;
-        // default log level
+        // default log level and sink
         res->log_level = UMD_LLT_INFO;
+        res->log_sinks = UMD_LST_SYSLOG;
+        res->log_ring_sz = UMD_LOG_RING_SZ;
         // set current running daemon
         UMD = res;
         return res;
@@ -81,6 +143,721 @@ umd_set_log_level(umdaemon_t *umd, enum umd_log_level_t ll)
     umd->log_level = ll;
 }
 
+int
+umd_set_log_sinks(umdaemon_t *umd, int sinks, const char *file)
+{
+    if (!umd || umd->logger) {
+        return 1;
+    }
+    // log file
+    if (sinks & UMD_LST_FILE) {
+        if (file == NULL) {
+            return 1;
+        }
+        FILE *fp = fopen(file, "a");
+        if (fp == NULL) {
+            return 1;
+        }
+        if (umd->log_fp != NULL) {
+            fclose(umd->log_fp);
+        }
+        umd->log_fp = fp;
+    }
+    umd->log_sinks = sinks;
+    return 0;
+}
+
+int
+umd_set_log_ring(umdaemon_t *umd, uint32_t sz)
+{
+    if (!umd || umd->logger || sz < UMD_LOG_RING_MIN || sz > UMD_LOG_RING_MAX) {
+        return 1;
+    }
+    // power of 2
+    uint32_t r_sz = UMD_LOG_RING_MIN;
+    while (r_sz < sz) {
+        r_sz <<= 1;
+    }
+    umd->log_ring_sz = r_sz;
+    return 0;
+}
+
+/*************/
+/* Log sinks */
+/*************/
+static const char *
+log_level_str(int level)
+{
+    switch (level) {
+    case UMD_LLT_ERROR:
+        return "ERROR";
+    case UMD_LLT_WARNING:
+        return "WARNING";
+    case UMD_LLT_INFO:
+        return "INFO";
+    case UMD_LLT_DEBUG:
+        return "DEBUG";
+    default:
+        return "LOG";
+    }
+}
+
+static void
+log_write_fp(umdaemon_t *umd,
+             FILE *fp,
+             int level,
+             const struct timespec *ts,
+             const char *msg)
+{
+    // formatted time (cached per second)
+    static __thread time_t t_last = -1;
+    static __thread char tbuf[32];
+    if (ts->tv_sec != t_last) {
+        struct tm tm;
+        localtime_r(&ts->tv_sec, &tm);
+        strftime(tbuf, sizeof(tbuf), "%Y-%m-%d %H:%M:%S", &tm);
+        t_last = ts->tv_sec;
+    }
+    fprintf(fp,
+            "%s.%03ld %s[%d] %s: %s\n",
+            tbuf,
+            ts->tv_nsec / 1000000,
+            umd->fqn,
+            (int)getpid(),
+            log_level_str(level),
+            msg);
+}
+
+// write record to all sinks
+static void
+log_write(umdaemon_t *umd, int level, const struct timespec *ts, const char *msg)
+{
+    if (umd->log_sinks & UMD_LST_SYSLOG) {
+        syslog(LOG_USER | level, "%s", msg);
+    }
+    if ((umd->log_sinks & UMD_LST_FILE) && umd->log_fp != NULL) {
+        log_write_fp(umd, umd->log_fp, level, ts, msg);
+    }
+    if (umd->log_sinks & UMD_LST_STDOUT) {
+        log_write_fp(umd, stdout, level, ts, msg);
+    }
+}
+
+// format message into buf, or into heap allocated
+// buffer if it does not fit (truncated on alloc error)
+static char *
+log_format(char *buf, size_t sz, const char *msg, va_list argp)
+{
+    va_list cp;
+    va_copy(cp, argp);
+    int n = vsnprintf(buf, sz, msg, cp);
+    va_end(cp);
+    if (n < 0 || n < sz) {
+        return buf;
+    }
+    char *b = malloc(n + 1);
+    if (b == NULL) {
+        return buf;
+    }
+    vsnprintf(b, n + 1, msg, argp);
+    return b;
+}
+
+static void
+log_sinks_flush(umdaemon_t *umd)
+{
+    if ((umd->log_sinks & UMD_LST_FILE) && umd->log_fp != NULL) {
+        fflush(umd->log_fp);
+    }
+    if (umd->log_sinks & UMD_LST_STDOUT) {
+        fflush(stdout);
+    }
+}
+
+/****************/
+/* Async logger */
+/****************/
+// owner thread exited
+static void
+log_ring_orphan(void *arg)
+{
+    struct umd_log_ring *r = arg;
+    UM_ATOMIC_COMP_SWAP(&r->orphan, 0, 1);
+}
+
+// get (or create) current thread's ring
+static struct umd_log_ring *
+log_ring_get(umdaemon_t *umd, umd_logger_t *l)
+{
+    if (log_ring != NULL) {
+        return log_ring;
+    }
+    // reuse ring of exited thread
+    struct umd_log_ring *r = UM_ATOMIC_COMP_SWAP(&l->rings, NULL, NULL);
+    for (; r != NULL; r = r->next) {
+        if (UM_ATOMIC_COMP_SWAP(&r->orphan, 1, 0) == 1) {
+            break;
+        }
+    }
+    // new ring
+    if (r == NULL) {
+        r = calloc(1,
+                   sizeof(struct umd_log_ring) +
+                       umd->log_ring_sz * sizeof(struct umd_log_rec));
+        if (r == NULL) {
+            return NULL;
+        }
+        r->mask = umd->log_ring_sz - 1;
+        for (;;) {
+            struct umd_log_ring *h = UM_ATOMIC_COMP_SWAP(&l->rings, NULL, NULL);
+            r->next = h;
+            if (UM_ATOMIC_COMP_SWAP(&l->rings, h, r) == h) {
+                break;
+            }
+        }
+    }
+    pthread_setspecific(l->key, r);
+    log_ring = r;
+    return r;
+}
+
+// drain all rings (flusher thread)
+static size_t
+log_drain(umdaemon_t *umd, umd_logger_t *l)
+{
+    size_t n = 0;
+    struct umd_log_ring *r = UM_ATOMIC_COMP_SWAP(&l->rings, NULL, NULL);
+    for (; r != NULL; r = r->next) {
+        uint32_t h = UM_ATOMIC_GET(&r->head);
+        for (; r->tail != h; n++) {
+            struct umd_log_rec *rec = &r->recs[r->tail & r->mask];
+            log_write(umd, rec->level, &rec->ts, (rec->ext != NULL ? rec->ext : rec->msg));
+            free(rec->ext);
+            rec->ext = NULL;
+            UM_ATOMIC_ADD_F(&r->tail, 1);
+        }
+        // report dropped records
+        uint32_t d = UM_ATOMIC_GET(&r->dropped);
+        if (d > 0) {
+            UM_ATOMIC_F_SUB(&r->dropped, d);
+            char msg[64];
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            snprintf(msg, sizeof(msg), "umd: [%u log messages dropped]", d);
+            log_write(umd, UMD_LLT_WARNING, &ts, msg);
+            n++;
+        }
+    }
+    if (n > 0) {
+        log_sinks_flush(umd);
+    }
+    return n;
+}
+
+// wake flusher (producer, ring half full)
+static void
+log_wake(umd_logger_t *l)
+{
+    pthread_mutex_lock(&l->mtx);
+    pthread_cond_signal(&l->cnd);
+    pthread_mutex_unlock(&l->mtx);
+}
+
+static void *
+log_flusher(void *arg)
+{
+    umdaemon_t *umd = arg;
+    umd_logger_t *l = umd->logger;
+    while (UM_ATOMIC_GET(&l->running)) {
+        if (log_drain(umd, l) > 0) {
+            continue;
+        }
+        // idle, wait for wakeup or timeout
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += UMD_LOG_IDLE_MS * 1000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+        pthread_mutex_lock(&l->mtx);
+        pthread_cond_timedwait(&l->cnd, &l->mtx, &ts);
+        pthread_mutex_unlock(&l->mtx);
+    }
+    // final drain
+    log_drain(umd, l);
+    return NULL;
+}
+
+static int
+log_start(umdaemon_t *umd)
+{
+    umd_logger_t *l = calloc(1, sizeof(umd_logger_t));
+    if (l == NULL) {
+        return 1;
+    }
+    if (pthread_key_create(&l->key, &log_ring_orphan)) {
+        free(l);
+        return 2;
+    }
+    pthread_mutex_init(&l->mtx, NULL);
+    pthread_cond_init(&l->cnd, NULL);
+    l->running = 1;
+    umd->logger = l;
+    if (pthread_create(&l->th, NULL, &log_flusher, umd)) {
+        umd->logger = NULL;
+        pthread_key_delete(l->key);
+        pthread_cond_destroy(&l->cnd);
+        pthread_mutex_destroy(&l->mtx);
+        free(l);
+        return 3;
+    }
+    return 0;
+}
+
+// stop flusher (rings are kept until
+// umd_destroy, logging becomes synchronous)
+static void
+log_stop(umdaemon_t *umd)
+{
+    umd_logger_t *l = umd->logger;
+    if (l == NULL || UM_ATOMIC_COMP_SWAP(&l->running, 1, 0) != 1) {
+        return;
+    }
+    log_wake(l);
+    pthread_join(l->th, NULL);
+}
+
+static void
+log_free(umdaemon_t *umd)
+{
+    umd_logger_t *l = umd->logger;
+    if (l == NULL) {
+        return;
+    }
+    log_stop(umd);
+    // records published while stopping
+    log_drain(umd, l);
+    umd->logger = NULL;
+    pthread_key_delete(l->key);
+    pthread_cond_destroy(&l->cnd);
+    pthread_mutex_destroy(&l->mtx);
+    struct umd_log_ring *r = l->rings;
+    while (r != NULL) {
+        struct umd_log_ring *n = r->next;
+        free(r);
+        r = n;
+    }
+    log_ring = NULL;
+    free(l);
+}
+
+/**************/
+/* Event loop */
+/**************/
+// io handler
+struct umd_io {
+    // file descriptor (key)
+    int fd;
+    // handler
+    umd_io_cb_t cb;
+    void *arg;
+    // owning timer (timerfd handlers)
+    umd_timer_t *timer;
+    // unregistered (freed by loop thread)
+    bool dead;
+    // next unregistered handler
+    struct umd_io *next_dead;
+    // hashable
+    UT_hash_handle hh;
+};
+
+// event loop timer
+struct umd_timer {
+    // timerfd handler
+    struct umd_io *io;
+    // handler
+    umd_timer_cb_t cb;
+    void *arg;
+};
+
+// event loop (epoll)
+struct umd_reactor {
+    // epoll, signal and wakeup fds
+    int epfd;
+    int sfd;
+    int efd;
+    // handlers (fd -> handler)
+    struct umd_io *ios;
+    // unregistered handlers
+    struct umd_io *dead;
+    // handlers lock
+    pthread_mutex_t mtx;
+    // signal mask before signals were blocked
+    sigset_t ss_old;
+};
+
+static uint32_t
+io_epoll_events(int events)
+{
+    uint32_t e = 0;
+    if (events & UMD_IO_READ) {
+        e |= EPOLLIN;
+    }
+    if (events & UMD_IO_WRITE) {
+        e |= EPOLLOUT;
+    }
+    return e;
+}
+
+static int
+io_umd_events(uint32_t e)
+{
+    int events = 0;
+    if (e & EPOLLIN) {
+        events |= UMD_IO_READ;
+    }
+    if (e & EPOLLOUT) {
+        events |= UMD_IO_WRITE;
+    }
+    if (e & (EPOLLERR | EPOLLHUP)) {
+        events |= UMD_IO_ERROR;
+    }
+    return events;
+}
+
+static void
+io_free(struct umd_io *io)
+{
+    if (io->timer != NULL) {
+        close(io->fd);
+        free(io->timer);
+    }
+    free(io);
+}
+
+// free unregistered handlers (loop thread)
+static void
+reactor_gc(umd_reactor_t *r)
+{
+    pthread_mutex_lock(&r->mtx);
+    struct umd_io *io = r->dead;
+    r->dead = NULL;
+    pthread_mutex_unlock(&r->mtx);
+    while (io != NULL) {
+        struct umd_io *n = io->next_dead;
+        io_free(io);
+        io = n;
+    }
+}
+
+// SIGTERM/SIGHUP (signalfd)
+static void
+reactor_on_signal(umdaemon_t *umd, int fd, int events, void *arg)
+{
+    struct signalfd_siginfo si;
+    while (read(fd, &si, sizeof(si)) == sizeof(si)) {
+        switch (si.ssi_signo) {
+        case SIGTERM:
+        case SIGINT:
+            UM_ATOMIC_COMP_SWAP(&umd->is_terminated, 0, 1);
+            break;
+        case SIGHUP:
+            umd_log(umd, UMD_LLT_INFO, "umd: [SIGHUP received]");
+            if (umd->on_reload) {
+                umd->on_reload(umd);
+            }
+            break;
+        }
+    }
+}
+
+// wakeup (eventfd)
+static void
+reactor_on_wakeup(umdaemon_t *umd, int fd, int events, void *arg)
+{
+    uint64_t v;
+    while (read(fd, &v, sizeof(v)) == sizeof(v)) {
+        // n/a
+    }
+}
+
+// timer expired (timerfd)
+static void
+reactor_on_timer(umdaemon_t *umd, int fd, int events, void *arg)
+{
+    umd_timer_t *t = arg;
+    uint64_t exp = 0;
+    if (read(fd, &exp, sizeof(exp)) == sizeof(exp) && exp > 0) {
+        t->cb(umd, t, exp, t->arg);
+    }
+}
+
+static void
+reactor_free(umdaemon_t *umd)
+{
+    umd_reactor_t *r = umd->reactor;
+    if (r == NULL) {
+        return;
+    }
+    umd->reactor = NULL;
+    struct umd_io *io, *tmp;
+    HASH_ITER(hh, r->ios, io, tmp)
+    {
+        HASH_DEL(r->ios, io);
+        io_free(io);
+    }
+    reactor_gc(r);
+    if (r->sfd >= 0) {
+        close(r->sfd);
+    }
+    if (r->efd >= 0) {
+        close(r->efd);
+    }
+    if (r->epfd >= 0) {
+        close(r->epfd);
+    }
+    pthread_mutex_destroy(&r->mtx);
+    free(r);
+}
+
+// signals handled by loop
+static void
+reactor_sigset(sigset_t *ss)
+{
+    sigemptyset(ss);
+    sigaddset(ss, SIGTERM);
+    sigaddset(ss, SIGINT);
+    sigaddset(ss, SIGHUP);
+}
+
+// forked child (e.g. os.execute/io.popen from
+// Lua), do not pass blocked signals to exec
+static void
+reactor_atfork_child(void)
+{
+    sigset_t ss;
+    reactor_sigset(&ss);
+    sigprocmask(SIG_UNBLOCK, &ss, NULL);
+}
+
+static void
+reactor_atfork_init(void)
+{
+    pthread_atfork(NULL, NULL, &reactor_atfork_child);
+}
+
+// create event loop; signals are blocked before any
+// other thread is created (inherited signal mask)
+static int
+reactor_new(umdaemon_t *umd)
+{
+    static pthread_once_t atfork_once = PTHREAD_ONCE_INIT;
+    umd_reactor_t *r = calloc(1, sizeof(umd_reactor_t));
+    if (r == NULL) {
+        return 1;
+    }
+    pthread_mutex_init(&r->mtx, NULL);
+    r->sfd = -1;
+    r->efd = -1;
+    umd->reactor = r;
+    // signals handled by loop (SIGHUP keeps its
+    // default action if there is no reload handler)
+    sigset_t ss;
+    reactor_sigset(&ss);
+    if (umd->on_reload == NULL) {
+        sigdelset(&ss, SIGHUP);
+    }
+    r->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (r->epfd < 0) {
+        reactor_free(umd);
+        return 2;
+    }
+    r->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (r->efd < 0 || umd_io_add(umd, r->efd, UMD_IO_READ, &reactor_on_wakeup, NULL)) {
+        reactor_free(umd);
+        return 3;
+    }
+    if (pthread_sigmask(SIG_BLOCK, &ss, &r->ss_old)) {
+        reactor_free(umd);
+        return 4;
+    }
+    pthread_once(&atfork_once, &reactor_atfork_init);
+    r->sfd = signalfd(-1, &ss, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (r->sfd < 0 || umd_io_add(umd, r->sfd, UMD_IO_READ, &reactor_on_signal, NULL)) {
+        pthread_sigmask(SIG_UNBLOCK, &ss, NULL);
+        reactor_free(umd);
+        return 5;
+    }
+    return 0;
+}
+
+// register handler (timer is linked with its
+// handler before events can be dispatched)
+static int
+io_add(umd_reactor_t *r, int fd, int events, umd_io_cb_t cb, void *arg, umd_timer_t *t)
+{
+    struct umd_io *io = calloc(1, sizeof(struct umd_io));
+    if (io == NULL) {
+        return 2;
+    }
+    io->fd = fd;
+    io->cb = cb;
+    io->arg = arg;
+    io->timer = t;
+    pthread_mutex_lock(&r->mtx);
+    // already registered
+    struct umd_io *e = NULL;
+    HASH_FIND_INT(r->ios, &fd, e);
+    if (e != NULL) {
+        pthread_mutex_unlock(&r->mtx);
+        free(io);
+        return 3;
+    }
+    HASH_ADD_INT(r->ios, fd, io);
+    if (t != NULL) {
+        t->io = io;
+    }
+    struct epoll_event ev = { .events = io_epoll_events(events), .data.ptr = io };
+    if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, fd, &ev)) {
+        HASH_DEL(r->ios, io);
+        if (t != NULL) {
+            t->io = NULL;
+        }
+        pthread_mutex_unlock(&r->mtx);
+        free(io);
+        return 4;
+    }
+    pthread_mutex_unlock(&r->mtx);
+    return 0;
+}
+
+int
+umd_io_add(umdaemon_t *umd, int fd, int events, umd_io_cb_t cb, void *arg)
+{
+    if (!umd || !umd->reactor || fd < 0 || cb == NULL) {
+        return 1;
+    }
+    return io_add(umd->reactor, fd, events, cb, arg, NULL);
+}
+
+int
+umd_io_mod(umdaemon_t *umd, int fd, int events)
+{
+    if (!umd || !umd->reactor) {
+        return 1;
+    }
+    umd_reactor_t *r = umd->reactor;
+    int ret = 0;
+    pthread_mutex_lock(&r->mtx);
+    struct umd_io *io = NULL;
+    HASH_FIND_INT(r->ios, &fd, io);
+    if (io == NULL) {
+        ret = 2;
+
+    } else {
+        struct epoll_event ev = { .events = io_epoll_events(events), .data.ptr = io };
+        if (epoll_ctl(r->epfd, EPOLL_CTL_MOD, fd, &ev)) {
+            ret = 3;
+        }
+    }
+    pthread_mutex_unlock(&r->mtx);
+    return ret;
+}
+
+int
+umd_io_del(umdaemon_t *umd, int fd)
+{
+    if (!umd || !umd->reactor) {
+        return 1;
+    }
+    umd_reactor_t *r = umd->reactor;
+    pthread_mutex_lock(&r->mtx);
+    struct umd_io *io = NULL;
+    HASH_FIND_INT(r->ios, &fd, io);
+    if (io == NULL) {
+        pthread_mutex_unlock(&r->mtx);
+        return 2;
+    }
+    epoll_ctl(r->epfd, EPOLL_CTL_DEL, fd, NULL);
+    HASH_DEL(r->ios, io);
+    // events for this handler might be pending
+    // in current loop iteration, free later
+    io->dead = true;
+    io->next_dead = r->dead;
+    r->dead = io;
+    pthread_mutex_unlock(&r->mtx);
+    return 0;
+}
+
+umd_timer_t *
+umd_timer_add(umdaemon_t *umd,
+              uint64_t delay,
+              uint64_t interval,
+              umd_timer_cb_t cb,
+              void *arg)
+{
+    if (!umd || !umd->reactor || cb == NULL) {
+        return NULL;
+    }
+    umd_timer_t *t = calloc(1, sizeof(umd_timer_t));
+    if (t == NULL) {
+        return NULL;
+    }
+    t->cb = cb;
+    t->arg = arg;
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) {
+        free(t);
+        return NULL;
+    }
+    // zero delay would disarm the timer
+    if (delay == 0) {
+        delay = 1;
+    }
+    // register and link timer and its handler
+    // (freed together), timer is not armed yet
+    if (io_add(umd->reactor, fd, UMD_IO_READ, &reactor_on_timer, t, t)) {
+        close(fd);
+        free(t);
+        return NULL;
+    }
+    // arm
+    struct itimerspec its = { .it_value = { delay / 1000, (delay % 1000) * 1000000 },
+                              .it_interval = { interval / 1000,
+                                               (interval % 1000) * 1000000 } };
+    if (timerfd_settime(fd, 0, &its, NULL)) {
+        // fd and timer are freed with handler
+        umd_io_del(umd, fd);
+        return NULL;
+    }
+    return t;
+}
+
+void
+umd_timer_del(umdaemon_t *umd, umd_timer_t *t)
+{
+    if (!umd || !umd->reactor || t == NULL) {
+        return;
+    }
+    // disarm, fd and timer are freed with handler
+    struct itimerspec its = { 0 };
+    timerfd_settime(t->io->fd, 0, &its, NULL);
+    umd_io_del(umd, t->io->fd);
+}
+
+void
+umd_wakeup(umdaemon_t *umd)
+{
+    if (!umd || !umd->reactor) {
+        return;
+    }
+    uint64_t v = 1;
+    if (write(umd->reactor->efd, &v, sizeof(v)) < 0) {
+        // counter overflow, loop is awake
+    }
+}
+
 void
 umd_signal_handler(int signum)
 {
@@ -90,6 +867,7 @@ umd_signal_handler(int signum)
     switch (signum) {
     case SIGTERM:
         UM_ATOMIC_COMP_SWAP(&UMD->is_terminated, 0, 1);
+        umd_wakeup(UMD);
         break;
     }
 }
@@ -110,6 +888,14 @@ umd_start(umdaemon_t *umd)
     openlog(umd->fqn, LOG_PID | LOG_CONS, LOG_USER);
     // log
     syslog(LOG_INFO, "starting...");
+    // event loop (before any thread is started)
+    if (reactor_new(umd)) {
+        syslog(LOG_WARNING, "cannot create event loop");
+    }
+    // start async logger (synchronous on error)
+    if (log_start(umd)) {
+        syslog(LOG_WARNING, "cannot start async logger");
+    }
     // call on init handler
     if (umd->on_init)
         umd->on_init(umd);
@@ -128,6 +914,8 @@ umd_terminate(umdaemon_t *umd)
     // call on terminate handler
     if (umd->on_terminate)
         umd->on_terminate(umd);
+    // flush and stop async logger
+    log_stop(umd);
     closelog();
 }
 
@@ -135,6 +923,14 @@ void
 umd_destroy(umdaemon_t *umd)
 {
     if (umd) {
+        reactor_free(umd);
+        log_free(umd);
+        if (umd->log_fp != NULL) {
+            fclose(umd->log_fp);
+        }
+        if (UMD == umd) {
+            UMD = NULL;
+        }
         free(umd->fqn);
         free(umd);
     }
@@ -143,8 +939,40 @@ umd_destroy(umdaemon_t *umd)
 void
 umd_loop(umdaemon_t *umd)
 {
-    while (!UM_ATOMIC_GET(&umd->is_terminated))
-        sleep(1);
+    umd_reactor_t *r = umd->reactor;
+    // no event loop, poll
+    if (r == NULL) {
+        while (!UM_ATOMIC_GET(&umd->is_terminated))
+            sleep(1);
+    }
+    // dispatch events until terminated
+    struct epoll_event evs[UMD_LOOP_EVENTS_MAX];
+    while (r != NULL && !UM_ATOMIC_GET(&umd->is_terminated)) {
+        int n = epoll_wait(r->epfd, evs, UMD_LOOP_EVENTS_MAX, -1);
+        if (n < 0 && errno != EINTR) {
+            umd_log(umd, UMD_LLT_ERROR, "umd: [epoll_wait error (%d)]", errno);
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            struct umd_io *io = evs[i].data.ptr;
+            // skip handlers unregistered in this iteration
+            pthread_mutex_lock(&r->mtx);
+            bool dead = io->dead;
+            pthread_mutex_unlock(&r->mtx);
+            if (!dead) {
+                io->cb(umd, io->fd, io_umd_events(evs[i].events), io->arg);
+            }
+        }
+        reactor_gc(r);
+    }
+    // signalfd is not read anymore, discard pending
+    // signals and restore signal mask
+    if (r != NULL) {
+        struct signalfd_siginfo si;
+        while (read(r->sfd, &si, sizeof(si)) == sizeof(si)) {
+        }
+        pthread_sigmask(SIG_SETMASK, &r->ss_old, NULL);
+    }
     // terminate
     umd_terminate(umd);
 }
@@ -152,14 +980,62 @@ umd_loop(umdaemon_t *umd)
 void
 umd_log(umdaemon_t *umd, enum umd_log_level_t level, const char *msg, ...)
 {
+    // log level check
+    if (level > umd->log_level) {
+        return;
+    }
     va_list argp;
     va_start(argp, msg);
-    // log level check
-    if (level <= umd->log_level) {
+    // async logger, format into ring (I/O is
+    // done by flusher thread)
+    umd_logger_t *l = umd->logger;
+    struct umd_log_ring *r = NULL;
+    if (l != NULL && UM_ATOMIC_GET(&l->running)) {
+        r = log_ring_get(umd, l);
+    }
+    if (r != NULL) {
+        uint32_t h = r->head;
+        uint32_t used = h - UM_ATOMIC_GET(&r->tail);
+        // last 1/8 of the ring is reserved for errors
+        uint32_t cap = r->mask + 1;
+        uint32_t lim = (level <= UMD_LLT_ERROR ? cap : cap - cap / 8);
+        // ring full, drop (reported by flusher)
+        if (used >= lim) {
+            UM_ATOMIC_ADD_F(&r->dropped, 1);
+
+        } else {
+            struct umd_log_rec *rec = &r->recs[h & r->mask];
+            rec->level = level;
+            clock_gettime(CLOCK_REALTIME, &rec->ts);
+            // long messages are kept in overflow buffer
+            char *m = log_format(rec->msg, sizeof(rec->msg), msg, argp);
+            rec->ext = (m != rec->msg ? m : NULL);
+            // publish
+            UM_ATOMIC_ADD_F(&r->head, 1);
+            // do not wait for idle timeout
+            if (used + 1 == cap / 2) {
+                log_wake(l);
+            }
+        }
+
+        // synchronous
+    } else if (umd->log_sinks == UMD_LST_SYSLOG) {
         // open log
         openlog(umd->fqn, LOG_PID | LOG_CONS, LOG_USER);
         // log
         vsyslog(LOG_USER | level, msg, argp);
+
+    } else {
+        char buf[UMD_LOG_MSG_MAX];
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        char *m = log_format(buf, sizeof(buf), msg, argp);
+        openlog(umd->fqn, LOG_PID | LOG_CONS, LOG_USER);
+        log_write(umd, level, &ts, m);
+        log_sinks_flush(umd);
+        if (m != buf) {
+            free(m);
+        }
     }
     va_end(argp);
 }
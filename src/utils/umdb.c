@@ -8,43 +8,161 @@
  *
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
 #include <umdb.h>
 
 /******************/
 /* sql statements */
 /******************/
-// authenticate user
+// authenticate user (single row lookup, stored
+// credential is verified in umdb_mngr_uauth)
 static const char *SQL_USER_AUTH =
-    "SELECT a.id, "
-    "       a.flags, "
-    "       a.username, "
-    "       iif(b.username is NULL, 0, 1) as auth "
-    "FROM user a "
-    "LEFT JOIN "
-    "   (SELECT flags, username  "
-    "    FROM user a "
-    "    WHERE username = ? AND "
-    "    password = ?) b "
-    "ON a.username = b.username "
-    "WHERE a.username = ?";
+    "SELECT id, flags, password FROM user "
+    "WHERE username = ?";
+
+// add user or update existing user (hashed credential)
+static const char *SQL_USER_ADD =
+    "INSERT INTO user (username, password, flags) VALUES (?, ?, ?) "
+    "ON CONFLICT(username) DO UPDATE SET "
+    "password = excluded.password, flags = excluded.flags";
 
 // get user
 static const char *SQL_USER_GET =
-    "SELECT * FROM user "
+    "SELECT id, flags FROM user "
     "WHERE username = ?";
 
+// db change counter (changes made by other connections)
+static const char *SQL_DATA_VERSION = "PRAGMA data_version";
+
+// list users
+static const char *SQL_USER_LIST =
+    "SELECT id, username, password, flags FROM user";
+
+// list ACL rules
+static const char *SQL_ACL_LIST =
+    "SELECT username, flags, topic, access FROM acl";
+
+// schema migrations (index = user_version before migration)
+static const char *SQL_MIGRATIONS[UMDB_SCHEMA_VERSION] = {
+    // v1: unique username index (auth lookups)
+    "CREATE UNIQUE INDEX IF NOT EXISTS user_username_idx ON user(username)",
+    // v2: topic pattern ACL rules
+    "CREATE TABLE IF NOT EXISTS acl ("
+    "   id INTEGER PRIMARY KEY, "
+    "   username TEXT, "
+    "   flags INTEGER, "
+    "   topic TEXT NOT NULL, "
+    "   access INTEGER NOT NULL DEFAULT 3)"
+};
+
+// sql statements (per query type)
+static const char **SQL_STMTS[UMDB_QUERY_NUM] = {
+    [USER_AUTH] = &SQL_USER_AUTH,
+    [USER_GET] = &SQL_USER_GET,
+    [DB_DATA_VERSION] = &SQL_DATA_VERSION,
+    [USER_LIST] = &SQL_USER_LIST,
+    [ACL_LIST] = &SQL_ACL_LIST
+};
+
+// get cached prepared statement (lock held by caller)
+static sqlite3_stmt *
+umdb_stmt_get(umdb_mngrd_t *m, enum query_type qt)
+{
+    if (m->stmts[qt] != NULL) {
+        return m->stmts[qt];
+    }
+    // not implemented
+    if (SQL_STMTS[qt] == NULL) {
+        return NULL;
+    }
+    // prepare (persistent, reused with reset/rebind)
+    if (sqlite3_prepare_v3(m->db,
+                           *SQL_STMTS[qt],
+                           -1,
+                           SQLITE_PREPARE_PERSISTENT,
+                           &m->stmts[qt],
+                           NULL) != SQLITE_OK) {
+        m->stmts[qt] = NULL;
+    }
+    return m->stmts[qt];
+}
+
+// reset statement for next use (lock held by caller)
+static int
+umdb_stmt_done(sqlite3_stmt *stmt)
+{
+    int r = sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    return r;
+}
+
+int
+umdb_migrate(const char *db)
+{
+    sqlite3 *db_p = NULL;
+    if (sqlite3_open_v2(db, &db_p, SQLITE_OPEN_READWRITE, NULL)) {
+        sqlite3_close(db_p);
+        return 1;
+    }
+    // current schema version
+    sqlite3_stmt *stmt = NULL;
+    int v = -1;
+    if (sqlite3_prepare_v2(db_p, "PRAGMA user_version", -1, &stmt, NULL) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            v = sqlite3_column_int(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+    if (v < 0) {
+        sqlite3_close(db_p);
+        return 2;
+    }
+    // apply missing migrations (one transaction each)
+    int ret = 0;
+    for (; v < UMDB_SCHEMA_VERSION; v++) {
+        char sql[512];
+        int r = snprintf(sql,
+                         sizeof(sql),
+                         "BEGIN; %s; PRAGMA user_version = %d; COMMIT;",
+                         SQL_MIGRATIONS[v],
+                         v + 1);
+        if (r <= 0 || r >= sizeof(sql)) {
+            ret = 3;
+            break;
+        }
+        if (sqlite3_exec(db_p, sql, NULL, NULL, NULL) != SQLITE_OK) {
+            sqlite3_exec(db_p, "ROLLBACK", NULL, NULL, NULL);
+            ret = 4;
+            break;
+        }
+    }
+    sqlite3_close(db_p);
+    return ret;
+}
+
 umdb_mngrd_t *
 umdb_mngr_new(const char *db)
 {
     sqlite3 *db_p = NULL;
     if (!sqlite3_open_v2(db, &db_p, SQLITE_OPEN_READONLY | SQLITE_OPEN_FULLMUTEX, NULL)) {
-        umdb_mngrd_t *m = malloc(sizeof(umdb_mngrd_t));
+        // retry instead of failing while db is being written
+        sqlite3_busy_timeout(db_p, UMDB_BUSY_TIMEOUT);
+        umdb_mngrd_t *m = calloc(1, sizeof(umdb_mngrd_t));
+        if (m == NULL) {
+            sqlite3_close(db_p);
+            return NULL;
+        }
         m->db = db_p;
+        pthread_mutex_init(&m->mtx, NULL);
         return m;
     }
-
+    // handle is allocated even on error
+    sqlite3_close(db_p);
     return NULL;
 }
 
@@ -54,9 +172,16 @@ umdb_mngr_free(umdb_mngrd_t *m)
     if (m == NULL) {
         return;
     }
+    // finalize cached statements
+    for (int i = 0; i < UMDB_QUERY_NUM; i++) {
+        if (m->stmts[i] != NULL) {
+            sqlite3_finalize(m->stmts[i]);
+        }
+    }
     if (m->db) {
         sqlite3_close(m->db);
     }
+    pthread_mutex_destroy(&m->mtx);
     free(m);
 }
 
@@ -66,97 +191,407 @@ umdb_mngr_uauth(umdb_mngrd_t *m, umdb_uauth_d_t *res, const char *u, const char
     if (m == NULL || m->db == NULL || res == NULL || u == NULL || p == NULL) {
         return 1;
     }
-    // prepare statement
-    sqlite3_stmt *stmt = NULL;
-    int r = sqlite3_prepare_v2(m->db, SQL_USER_AUTH, -1, &stmt, NULL);
-    if (r != SQLITE_OK) {
+    int ret = 0;
+    // stored credential (copy)
+    char *stored = NULL;
+    // lock
+    pthread_mutex_lock(&m->mtx);
+    // cached statement
+    sqlite3_stmt *stmt = umdb_stmt_get(m, USER_AUTH);
+    if (stmt == NULL) {
+        pthread_mutex_unlock(&m->mtx);
         return 2;
     }
 
     // username
     if (sqlite3_bind_text(stmt, 1, u, strlen(u), SQLITE_STATIC)) {
-        return 3;
+        ret = 3;
+
+        // step
+    } else {
+        int usr_flags = 0;
+        int usr_id = -1;
+        int auth = -1;
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            usr_id = sqlite3_column_int(stmt, 0);
+            usr_flags = sqlite3_column_int(stmt, 1);
+            // copy stored credential (verified
+            // after the lock is released)
+            const char *pwd = (const char *)sqlite3_column_text(stmt, 2);
+            if (pwd == NULL) {
+                auth = 0;
+            } else if ((stored = strdup(pwd)) == NULL) {
+                ret = 4;
+            }
+        }
+
+        // user auth result
+        res->auth = auth;
+        res->id = usr_id;
+        res->flags = usr_flags;
     }
-    // pwd
-    if (sqlite3_bind_text(stmt, 2, p, strlen(p), SQLITE_STATIC)) {
-        return 4;
+
+    // reset for next use
+    if (umdb_stmt_done(stmt) && ret == 0) {
+        ret = 7;
+    }
+    umdb_cred_verify_t verify = m->verify;
+    void *verify_arg = m->verify_arg;
+    // unlock
+    pthread_mutex_unlock(&m->mtx);
+
+    // verify stored credential (PBKDF2 is slow,
+    // other lookups are not blocked)
+    if (stored != NULL) {
+        if (ret == 0 && verify != NULL) {
+            res->auth = (verify(u, stored, p, verify_arg) == 1);
+        } else if (ret == 0) {
+            res->auth = (umdb_cred_verify(stored, p) == 1);
+        }
+        // clear credential copy
+        OPENSSL_cleanse(stored, strlen(stored));
+        free(stored);
+    }
+    return ret;
+}
+
+int
+umdb_mngr_uget(umdb_mngrd_t *m, umdb_uauth_d_t *res, const char *u)
+{
+    if (m == NULL || m->db == NULL || res == NULL || u == NULL) {
+        return 1;
+    }
+    int ret = 0;
+    // lock
+    pthread_mutex_lock(&m->mtx);
+    // cached statement
+    sqlite3_stmt *stmt = umdb_stmt_get(m, USER_GET);
+    if (stmt == NULL) {
+        pthread_mutex_unlock(&m->mtx);
+        return 2;
     }
+
     // username
-    if (sqlite3_bind_text(stmt, 3, u, strlen(u), SQLITE_STATIC)) {
-        return 5;
+    if (sqlite3_bind_text(stmt, 1, u, strlen(u), SQLITE_STATIC)) {
+        ret = 3;
+
+        // step
+    } else {
+        int usr_flags = 0;
+        int usr_id = -1;
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            usr_id = sqlite3_column_int(stmt, 0);
+            usr_flags = sqlite3_column_int(stmt, 1);
+        }
+
+        // user get result
+        res->id = usr_id;
+        res->flags = usr_flags;
+        res->usr = u;
     }
 
+    // reset for next use
+    if (umdb_stmt_done(stmt) && ret == 0) {
+        ret = 7;
+    }
+    // unlock
+    pthread_mutex_unlock(&m->mtx);
+    return ret;
+}
+
+int
+umdb_mngr_data_version(umdb_mngrd_t *m, int *v)
+{
+    if (m == NULL || m->db == NULL || v == NULL) {
+        return 1;
+    }
+    int ret = 0;
+    // lock
+    pthread_mutex_lock(&m->mtx);
+    // cached statement
+    sqlite3_stmt *stmt = umdb_stmt_get(m, DB_DATA_VERSION);
+    if (stmt == NULL) {
+        pthread_mutex_unlock(&m->mtx);
+        return 2;
+    }
     // step
-    int usr_flags = 0;
-    int usr_id = -1;
-    int auth = -1;
     if (sqlite3_step(stmt) == SQLITE_ROW) {
-        usr_id = sqlite3_column_int(stmt, 0);
-        usr_flags = sqlite3_column_int(stmt, 1);
-        auth = sqlite3_column_int(stmt, 3);
+        *v = sqlite3_column_int(stmt, 0);
+    } else {
+        ret = 3;
+    }
+    // reset for next use
+    if (umdb_stmt_done(stmt) && ret == 0) {
+        ret = 7;
+    }
+    // unlock
+    pthread_mutex_unlock(&m->mtx);
+    return ret;
+}
+
+int
+umdb_mngr_ulist(umdb_mngrd_t *m, umdb_ulist_cb_t cb, void *arg)
+{
+    if (m == NULL || m->db == NULL || cb == NULL) {
+        return 1;
     }
-    // cleanup
-    if (sqlite3_clear_bindings(stmt)) {
-        return 6;
+    int ret = 0;
+    // lock
+    pthread_mutex_lock(&m->mtx);
+    // cached statement
+    sqlite3_stmt *stmt = umdb_stmt_get(m, USER_LIST);
+    if (stmt == NULL) {
+        pthread_mutex_unlock(&m->mtx);
+        return 2;
+    }
+    // step (all rows)
+    int r;
+    while ((r = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const char *usr = (const char *)sqlite3_column_text(stmt, 1);
+        const char *pwd = (const char *)sqlite3_column_text(stmt, 2);
+        umdb_uauth_d_t u = { .auth = 0,
+                             .id = sqlite3_column_int(stmt, 0),
+                             .flags = sqlite3_column_int(stmt, 3),
+                             .usr = (usr != NULL ? usr : "") };
+        if (cb(&u, (pwd != NULL ? pwd : ""), arg)) {
+            ret = 4;
+            break;
+        }
     }
-    if (sqlite3_reset(stmt)) {
-        return 7;
+    if (ret == 0 && r != SQLITE_DONE) {
+        ret = 3;
     }
-    if (sqlite3_finalize(stmt)) {
-        return 8;
+    // reset for next use
+    if (umdb_stmt_done(stmt) && ret == 0) {
+        ret = 7;
     }
+    // unlock
+    pthread_mutex_unlock(&m->mtx);
+    return ret;
+}
 
-    // user auth result
-    res->auth = auth;
-    res->id = usr_id;
-    res->flags = usr_flags;
+int
+umdb_mngr_acl_list(umdb_mngrd_t *m, umdb_acl_cb_t cb, void *arg)
+{
+    if (m == NULL || m->db == NULL || cb == NULL) {
+        return 1;
+    }
+    int ret = 0;
+    // lock
+    pthread_mutex_lock(&m->mtx);
+    // cached statement (acl table might be missing)
+    sqlite3_stmt *stmt = umdb_stmt_get(m, ACL_LIST);
+    if (stmt == NULL) {
+        // missing table is a schema error, anything
+        // else (busy, locked, io) is a db error
+        ret = (sqlite3_errcode(m->db) == SQLITE_ERROR ? UMDB_ACL_NO_TABLE : 2);
+        pthread_mutex_unlock(&m->mtx);
+        return ret;
+    }
+    // step (all rows)
+    int r;
+    while ((r = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const char *topic = (const char *)sqlite3_column_text(stmt, 2);
+        if (topic == NULL) {
+            continue;
+        }
+        umdb_acl_d_t acl = {
+            .usr = (const char *)sqlite3_column_text(stmt, 0),
+            .flags = (sqlite3_column_type(stmt, 1) == SQLITE_NULL ?
+                      -1 :
+                      sqlite3_column_int(stmt, 1)),
+            .topic = topic,
+            .access = sqlite3_column_int(stmt, 3)
+        };
+        if (cb(&acl, arg)) {
+            ret = 4;
+            break;
+        }
+    }
+    if (ret == 0 && r != SQLITE_DONE) {
+        ret = 3;
+    }
+    // reset for next use
+    if (umdb_stmt_done(stmt) && ret == 0) {
+        ret = 7;
+    }
+    // unlock
+    pthread_mutex_unlock(&m->mtx);
+    return ret;
+}
 
-    // success
-    return 0;
+void
+umdb_mngr_set_verify(umdb_mngrd_t *m, umdb_cred_verify_t f, void *arg)
+{
+    if (m == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&m->mtx);
+    m->verify = f;
+    m->verify_arg = arg;
+    pthread_mutex_unlock(&m->mtx);
 }
 
 int
-umdb_mngr_uget(umdb_mngrd_t *m, umdb_uauth_d_t *res, const char *u)
+umdb_user_add(const char *db, const char *u, const char *p, int flags)
 {
-    if (m == NULL || m->db == NULL || res == NULL || u == NULL) {
+    if (db == NULL || u == NULL || p == NULL) {
         return 1;
     }
-    // prepare statement
-    sqlite3_stmt *stmt = NULL;
-    int r = sqlite3_prepare_v2(m->db, SQL_USER_GET, -1, &stmt, NULL);
-    if (r != SQLITE_OK) {
+    // unique username index is required
+    if (umdb_migrate(db)) {
         return 2;
     }
-
-    // username
-    if (sqlite3_bind_text(stmt, 1, u, strlen(u), SQLITE_STATIC)) {
+    // hashed credential
+    char h[UMDB_CRED_MAX];
+    if (umdb_cred_hash(p, 0, h, sizeof(h))) {
         return 3;
     }
+    sqlite3 *db_p = NULL;
+    if (sqlite3_open_v2(db, &db_p, SQLITE_OPEN_READWRITE, NULL)) {
+        sqlite3_close(db_p);
+        return 4;
+    }
+    int ret = 0;
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(db_p, SQL_USER_ADD, -1, &stmt, NULL) != SQLITE_OK) {
+        ret = 5;
 
-    // step
-    int usr_flags = 0;
-    int usr_id = -1;
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        usr_id = sqlite3_column_int(stmt, 0);
-        usr_flags = sqlite3_column_int(stmt, 3);
+        // bind and step
+    } else {
+        if (sqlite3_bind_text(stmt, 1, u, strlen(u), SQLITE_STATIC) ||
+            sqlite3_bind_text(stmt, 2, h, strlen(h), SQLITE_STATIC) ||
+            sqlite3_bind_int(stmt, 3, flags)) {
+            ret = 6;
+        } else if (sqlite3_step(stmt) != SQLITE_DONE) {
+            ret = 7;
+        }
+        sqlite3_finalize(stmt);
     }
+    sqlite3_close(db_p);
+    return ret;
+}
 
-    // cleanup
-    if (sqlite3_clear_bindings(stmt)) {
-        return 6;
+/**********************/
+/* credential hashing */
+/**********************/
+static void
+cred_hex(const unsigned char *b, size_t sz, char *out)
+{
+    static const char *hex = "0123456789abcdef";
+    for (size_t i = 0; i < sz; i++) {
+        out[i * 2] = hex[b[i] >> 4];
+        out[i * 2 + 1] = hex[b[i] & 0x0f];
     }
-    if (sqlite3_reset(stmt)) {
-        return 7;
+    out[sz * 2] = '\0';
+}
+
+static int
+cred_unhex(const char *s, size_t s_sz, unsigned char *out, size_t out_sz)
+{
+    if (s_sz % 2 != 0 || s_sz / 2 > out_sz) {
+        return -1;
     }
-    if (sqlite3_finalize(stmt)) {
-        return 8;
+    for (size_t i = 0; i < s_sz / 2; i++) {
+        int v = 0;
+        for (int j = 0; j < 2; j++) {
+            char c = s[i * 2 + j];
+            v <<= 4;
+            if (c >= '0' && c <= '9') {
+                v |= c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                v |= c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                v |= c - 'A' + 10;
+            } else {
+                return -1;
+            }
+        }
+        out[i] = v;
     }
+    return s_sz / 2;
+}
 
-    // user get result
-    res->id = usr_id;
-    res->flags = usr_flags;
-    res->usr = u;
+int
+umdb_cred_is_hashed(const char *stored)
+{
+    return stored != NULL &&
+           strncmp(stored, UMDB_CRED_PREFIX, sizeof(UMDB_CRED_PREFIX) - 1) == 0;
+}
 
-    // success
+int
+umdb_cred_hash(const char *p, int iter, char *out, size_t out_sz)
+{
+    if (p == NULL || out == NULL || out_sz < UMDB_CRED_MAX) {
+        return 1;
+    }
+    if (iter <= 0) {
+        iter = UMDB_CRED_ITER;
+    }
+    // random salt
+    unsigned char salt[UMDB_CRED_SALT_SZ];
+    if (RAND_bytes(salt, sizeof(salt)) != 1) {
+        return 2;
+    }
+    // derive key
+    unsigned char h[UMDB_CRED_HASH_SZ];
+    if (PKCS5_PBKDF2_HMAC(p,
+                          strlen(p),
+                          salt,
+                          sizeof(salt),
+                          iter,
+                          EVP_sha256(),
+                          sizeof(h),
+                          h) != 1) {
+        return 3;
+    }
+    char salt_h[UMDB_CRED_SALT_SZ * 2 + 1];
+    char h_h[UMDB_CRED_HASH_SZ * 2 + 1];
+    cred_hex(salt, sizeof(salt), salt_h);
+    cred_hex(h, sizeof(h), h_h);
+    int r = snprintf(out, out_sz, "%s%d$%s$%s", UMDB_CRED_PREFIX, iter, salt_h, h_h);
+    if (r <= 0 || r >= out_sz) {
+        return 4;
+    }
     return 0;
 }
+
+int
+umdb_cred_verify(const char *stored, const char *p)
+{
+    if (stored == NULL || p == NULL) {
+        return 0;
+    }
+    // plaintext (not migrated)
+    if (!umdb_cred_is_hashed(stored)) {
+        size_t s_sz = strlen(stored);
+        return s_sz == strlen(p) && CRYPTO_memcmp(stored, p, s_sz) == 0;
+    }
+    // parse iterations, salt and hash
+    const char *s = stored + sizeof(UMDB_CRED_PREFIX) - 1;
+    char *end = NULL;
+    long iter = strtol(s, &end, 10);
+    if (end == s || *end != '$' || iter <= 0 || iter > 100000000) {
+        return 0;
+    }
+    const char *salt_h = end + 1;
+    const char *h_h = strchr(salt_h, '$');
+    if (h_h == NULL) {
+        return 0;
+    }
+    unsigned char salt[64];
+    unsigned char h[UMDB_CRED_HASH_SZ];
+    int salt_sz = cred_unhex(salt_h, h_h - salt_h, salt, sizeof(salt));
+    h_h++;
+    if (salt_sz <= 0 ||
+        cred_unhex(h_h, strlen(h_h), h, sizeof(h)) != UMDB_CRED_HASH_SZ) {
+        return 0;
+    }
+    // derive and compare (constant time)
+    unsigned char d[UMDB_CRED_HASH_SZ];
+    if (PKCS5_PBKDF2_HMAC(p, strlen(p), salt, salt_sz, iter, EVP_sha256(), sizeof(d), d) !=
+        1) {
+        return 0;
+    }
+    return CRYPTO_memcmp(d, h, sizeof(d)) == 0;
+}
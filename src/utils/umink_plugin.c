@@ -11,8 +11,67 @@
 #include <umink_pkg_config.h>
 #include <umink_plugin.h>
 #include <umdaemon.h>
+#include <umatomic.h>
 #include <dlfcn.h>
 #include <stdio.h>
+#include <inttypes.h>
+#include <strings.h>
+#include <stddef.h>
+#include <umink_cmd_map.h>
+
+/**********************/
+/* async signal queue */
+/**********************/
+// queued signal
+struct umplg_sigq_item {
+    // signal handler
+    umplg_sh_t *sh;
+    // signal input data (copy)
+    umplg_data_std_t d;
+};
+
+// bounded signal queue
+struct umplg_sigq_q {
+    // ring buffer
+    struct umplg_sigq_item *items;
+    // ring buffer size
+    uint32_t depth;
+    // first queued item
+    uint32_t head;
+    // number of queued items
+    uint32_t count;
+    // dropped signals
+    uint64_t dropped;
+    // lock
+    pthread_mutex_t mtx;
+    // condition vars
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+};
+
+// signal queue worker
+struct umplg_sigq_wrk {
+    // worker thread
+    pthread_t th;
+    // queue (shared or per worker)
+    struct umplg_sigq_q *q;
+    // signal queue descriptor
+    umplg_sigq_t *sq;
+};
+
+// async signal queue descriptor
+struct umplg_sigq {
+    // config
+    umplg_sigq_cfg_t cfg;
+    // queues (one per worker if
+    // ordered, otherwise one shared)
+    struct umplg_sigq_q *qs;
+    uint32_t qs_n;
+    // workers
+    struct umplg_sigq_wrk *wrks;
+    // stop flag
+    uint8_t stopping;
+};
 
 umplgd_t *
 umplg_load(umplg_mngr_t *pm, const char *fpath)
@@ -31,6 +90,8 @@ umplg_load(umplg_mngr_t *pm, const char *fpath)
     umplg_termh_t term = dlsym(h, UMPLG_TERM_FN);
     umplg_cmdh_t cmdh = dlsym(h, UMPLG_CMD_HNDLR);
     umplg_cmdh_t cmdh_l = dlsym(h, UMPLG_CMD_HNDLR_LOCAL);
+    // optional features
+    const uint32_t *feats = dlsym(h, UMPLG_FEAT_LST);
 
     // first 4 must exist
     if (!(reg_hooks && init && term && cmdh)) {
@@ -55,6 +116,7 @@ umplg_load(umplg_mngr_t *pm, const char *fpath)
     umplgd_t pd = { .handle = h,
                     .name = strdup(fpath),
                     .type = 0,
+                    .features = (feats ? *feats : 0),
                     .cmdh = cmdh,
                     .cmdh_l = cmdh_l,
                     .termh = term,
@@ -72,6 +134,14 @@ umplg_load(umplg_mngr_t *pm, const char *fpath)
         hook->plgp = pdp;
         // add to map
         HASH_ADD_INT(pm->hooks, id, hook);
+        // add to dispatch table
+        if (hook->id >= 0 && hook->id < UMPLG_HK_TBL_SZ) {
+            umplg_hk_slot_t *slot = &pm->hk_tbl[hook->id];
+            slot->plgp = pdp;
+            slot->features = pdp->features;
+            slot->cmdh = pdp->cmdh;
+            slot->cmdh_l = pdp->cmdh_l;
+        }
         // next
         tmp_rh++;
     }
@@ -91,6 +161,28 @@ umplg_unload(umplg_mngr_t *pm, umplgd_t *pd)
 int
 umplg_run(umplg_mngr_t *pm, int cmd_id, int idt, umplg_idata_t *data, bool is_local)
 {
+    // find plugin from cmd_id (dispatch table)
+    if (cmd_id >= 0 && cmd_id < UMPLG_HK_TBL_SZ) {
+        umplg_hk_slot_t *slot = &pm->hk_tbl[cmd_id];
+        if (slot->plgp == NULL) {
+            return 1;
+        }
+        // standard data adapter
+        if (data != NULL && data->type == UMPLG_DT_STANDARD &&
+            !(slot->features & UMPLG_FEAT_STDD_ZC)) {
+            umplg_stdd_legacy(data->data);
+        }
+        // local
+        if (is_local) {
+            // handler implemented? (optional)
+            if (slot->cmdh_l == NULL) {
+                return -1;
+            }
+            return slot->cmdh_l(pm, slot->plgp, cmd_id, data);
+        }
+        // remote
+        return slot->cmdh(pm, slot->plgp, cmd_id, data);
+    }
 
     // find plugin from cmd_id (hook)
     umplg_hkd_t *hook = NULL;
@@ -98,6 +190,11 @@ umplg_run(umplg_mngr_t *pm, int cmd_id, int idt, umplg_idata_t *data, bool is_lo
     if (hook == NULL) {
         return 1;
     }
+    // standard data adapter
+    if (data != NULL && data->type == UMPLG_DT_STANDARD &&
+        !(hook->plgp->features & UMPLG_FEAT_STDD_ZC)) {
+        umplg_stdd_legacy(data->data);
+    }
     // local
     if (is_local) {
         // handler implemented? (optional)
@@ -138,6 +235,16 @@ umplg_reg_signal(umplg_mngr_t *pm, umplg_sh_t *sh)
     return 0;
 }
 
+static int
+sig_run(umplg_sh_t *sh, umplg_data_std_t *d_in, char **d_out, size_t *out_sz)
+{
+    // standard data adapter
+    if (!(sh->flags & UMPLG_FEAT_STDD_ZC)) {
+        umplg_stdd_legacy(d_in);
+    }
+    return sh->run(sh, d_in, d_out, out_sz);
+}
+
 int
 umplg_proc_signal(umplg_mngr_t *pm,
                   const char *s,
@@ -154,16 +261,315 @@ umplg_proc_signal(umplg_mngr_t *pm,
         return 1;
     }
     // run
-    return tmp_shd->run(tmp_shd, d_in, d_out, out_sz);
+    return sig_run(tmp_shd, d_in, d_out, out_sz);
+}
+
+int
+umplg_proc_signal_stdd(umplg_mngr_t *pm,
+                       const char *s,
+                       umplg_data_std_t *d_in,
+                       umplg_data_std_t *d_out)
+{
+    // single handler descriptor
+    umplg_sh_t *tmp_shd = NULL;
+    // find signal
+    HASH_FIND_STR(pm->signals, s, tmp_shd);
+    if (tmp_shd == NULL) {
+        return 1;
+    }
+    // structured output
+    if (tmp_shd->run_stdd != NULL) {
+        // standard data adapter
+        if (!(tmp_shd->flags & UMPLG_FEAT_STDD_ZC)) {
+            umplg_stdd_legacy(d_in);
+        }
+        return tmp_shd->run_stdd(tmp_shd, d_in, d_out);
+    }
+    // string output (single column row,
+    // size includes NUL terminator)
+    char *b = NULL;
+    size_t sz = 0;
+    int res = sig_run(tmp_shd, d_in, &b, &sz);
+    if (b != NULL) {
+        umplg_stdd_row_t *row = umplg_stdd_row_new(d_out, 1);
+        if (umplg_stdd_col_add_copy(d_out, row, "", b, (sz > 0 ? sz - 1 : 0)) && res == 0) {
+            res = 2;
+        }
+        free(b);
+    }
+    return res;
+}
+
+static void
+sigq_q_init(struct umplg_sigq_q *q, uint32_t depth)
+{
+    q->items = calloc(depth, sizeof(struct umplg_sigq_item));
+    q->depth = depth;
+    q->head = 0;
+    q->count = 0;
+    q->dropped = 0;
+    pthread_mutex_init(&q->mtx, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
 }
 
 static void
-add_cmd_id_map_item(int cmd_id, const char *name, umplg_mngr_t *pm)
+sigq_q_free(struct umplg_sigq_q *q)
+{
+    // free unprocessed signals
+    while (q->count > 0) {
+        umplg_stdd_free(&q->items[q->head].d);
+        q->head = (q->head + 1) % q->depth;
+        q->count--;
+    }
+    pthread_cond_destroy(&q->not_full);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_mutex_destroy(&q->mtx);
+    free(q->items);
+}
+
+static void
+sigq_stdd_copy(umplg_data_std_t *dst, umplg_data_std_t *src)
+{
+    memset(dst, 0, sizeof(umplg_data_std_t));
+    umplg_stdd_init(dst);
+    if (src == NULL) {
+        return;
+    }
+    // deep copy (std_items_copy)
+    if (src->items != NULL) {
+        utarray_concat(dst->items, src->items);
+    }
+    // copy zero-copy rows to arena
+    for (size_t i = 0; i < src->rows_n; i++) {
+        umplg_stdd_row_t *s_row = &src->rows[i];
+        umplg_stdd_row_t *d_row = umplg_stdd_row_new(dst, s_row->n);
+        for (size_t j = 0; j < s_row->n; j++) {
+            umplg_stdd_col_t *c = &s_row->cols[j];
+            if (umplg_stdd_col_add_copy(dst, d_row, c->name, c->value, c->sz) == 0) {
+                // keep value type
+                d_row->cols[d_row->n - 1].type = c->type;
+                d_row->cols[d_row->n - 1].num = c->num;
+            }
+        }
+    }
+}
+
+static void *
+sigq_worker(void *arg)
+{
+    struct umplg_sigq_wrk *w = arg;
+    struct umplg_sigq_q *q = w->q;
+
+    for (;;) {
+        pthread_mutex_lock(&q->mtx);
+        // wait for signal
+        while (q->count == 0 && !UM_ATOMIC_GET(&w->sq->stopping)) {
+            pthread_cond_wait(&q->not_empty, &q->mtx);
+        }
+        // stopped and drained
+        if (q->count == 0) {
+            pthread_mutex_unlock(&q->mtx);
+            break;
+        }
+        // dequeue
+        struct umplg_sigq_item it = q->items[q->head];
+        q->head = (q->head + 1) % q->depth;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+        pthread_mutex_unlock(&q->mtx);
+
+        // run handler (output is discarded)
+        char *b = NULL;
+        size_t b_sz = 0;
+        sig_run(it.sh, &it.d, &b, &b_sz);
+        free(b);
+        umplg_stdd_free(&it.d);
+    }
+
+    return NULL;
+}
+
+int
+umplg_start_async(umplg_mngr_t *pm, const umplg_sigq_cfg_t *cfg)
+{
+    // sanity check
+    if (pm == NULL || cfg == NULL || cfg->workers == 0 || cfg->depth == 0) {
+        return 1;
+    }
+    // already started
+    if (pm->sigq != NULL) {
+        return 2;
+    }
+    umplg_sigq_t *sq = calloc(1, sizeof(umplg_sigq_t));
+    sq->cfg = *cfg;
+    // ordered: queue per worker
+    sq->qs_n = (cfg->ordered ? cfg->workers : 1);
+    sq->qs = calloc(sq->qs_n, sizeof(struct umplg_sigq_q));
+    for (uint32_t i = 0; i < sq->qs_n; i++) {
+        sigq_q_init(&sq->qs[i], cfg->depth);
+    }
+    // start workers
+    sq->wrks = calloc(cfg->workers, sizeof(struct umplg_sigq_wrk));
+    for (uint32_t i = 0; i < cfg->workers; i++) {
+        struct umplg_sigq_wrk *w = &sq->wrks[i];
+        w->sq = sq;
+        w->q = &sq->qs[i % sq->qs_n];
+        if (pthread_create(&w->th, NULL, &sigq_worker, w)) {
+            umd_log(UMD, UMD_LLT_ERROR, "umplg_start_async: cannot start worker");
+            // stop already started workers
+            sq->cfg.workers = i;
+            pm->sigq = sq;
+            umplg_stop_async(pm);
+            return 3;
+        }
+    }
+    (void)UM_ATOMIC_COMP_SWAP(&pm->sigq, NULL, sq);
+    umd_log(UMD,
+            UMD_LLT_INFO,
+            "umplg_start_async: [workers = %u, depth = %u]",
+            cfg->workers,
+            cfg->depth);
+
+    return 0;
+}
+
+// wait for in-flight async signal producers
+static void
+sigq_wait_producers(umplg_mngr_t *pm)
+{
+    pthread_mutex_lock(&pm->sig_mtx);
+    (void)UM_ATOMIC_COMP_SWAP(&pm->sig_waiting, 0, 1);
+    while (UM_ATOMIC_GET(&pm->sig_refs) > 0) {
+        pthread_cond_wait(&pm->sig_idle, &pm->sig_mtx);
+    }
+    (void)UM_ATOMIC_COMP_SWAP(&pm->sig_waiting, 1, 0);
+    pthread_mutex_unlock(&pm->sig_mtx);
+}
+
+void
+umplg_stop_async(umplg_mngr_t *pm)
 {
-    umplg_cmd_map_t *cmd = malloc(sizeof(umplg_cmd_map_t));
-    cmd->id = cmd_id;
-    cmd->name = name;
-    HASH_ADD_KEYPTR(hh, pm->cmd_map, cmd->name, strlen(cmd->name), cmd);
+    umplg_sigq_t *sq = UM_ATOMIC_COMP_SWAP(&pm->sigq, NULL, NULL);
+    if (sq == NULL) {
+        return;
+    }
+    // stop accepting new signals (new producers
+    // do not see the queue anymore)
+    UM_ATOMIC_COMP_SWAP(&sq->stopping, 0, 1);
+    (void)UM_ATOMIC_COMP_SWAP(&pm->sigq, sq, NULL);
+    // wake up workers
+    for (uint32_t i = 0; i < sq->qs_n; i++) {
+        pthread_mutex_lock(&sq->qs[i].mtx);
+        pthread_cond_broadcast(&sq->qs[i].not_empty);
+        pthread_cond_broadcast(&sq->qs[i].not_full);
+        pthread_mutex_unlock(&sq->qs[i].mtx);
+    }
+    // producers still using the queue (producers
+    // blocked on full queue were woken up above)
+    sigq_wait_producers(pm);
+    // wait for workers
+    for (uint32_t i = 0; i < sq->cfg.workers; i++) {
+        pthread_join(sq->wrks[i].th, NULL);
+    }
+    // free queues
+    for (uint32_t i = 0; i < sq->qs_n; i++) {
+        if (sq->qs[i].dropped > 0) {
+            umd_log(UMD,
+                    UMD_LLT_WARNING,
+                    "umplg_stop_async: [queue %u dropped %lu signals]",
+                    i,
+                    (unsigned long)sq->qs[i].dropped);
+        }
+        sigq_q_free(&sq->qs[i]);
+    }
+    free(sq->qs);
+    free(sq->wrks);
+    free(sq);
+}
+
+// queue signal (caller is counted as in-flight producer)
+static int
+sigq_push(umplg_mngr_t *pm, const char *s, umplg_data_std_t *d_in)
+{
+    // plugin manager is being freed
+    if (UM_ATOMIC_GET(&pm->sig_closed)) {
+        return 2;
+    }
+    // single handler descriptor
+    umplg_sh_t *tmp_shd = NULL;
+    // find signal
+    HASH_FIND_STR(pm->signals, s, tmp_shd);
+    if (tmp_shd == NULL) {
+        return 1;
+    }
+    // async processing not started, run now
+    umplg_sigq_t *sq = UM_ATOMIC_COMP_SWAP(&pm->sigq, NULL, NULL);
+    if (sq == NULL) {
+        char *b = NULL;
+        size_t b_sz = 0;
+        int r = sig_run(tmp_shd, d_in, &b, &b_sz);
+        free(b);
+        return r;
+    }
+    // stopping
+    if (UM_ATOMIC_GET(&sq->stopping)) {
+        return 2;
+    }
+    // select queue (same signal, same queue)
+    struct umplg_sigq_q *q = &sq->qs[tmp_shd->hh.hashv % sq->qs_n];
+
+    pthread_mutex_lock(&q->mtx);
+    // queue full
+    if (q->count == q->depth) {
+        switch (sq->cfg.policy) {
+        case UMPLG_SQ_DROP_NEW:
+            q->dropped++;
+            pthread_mutex_unlock(&q->mtx);
+            return 3;
+
+        case UMPLG_SQ_DROP_OLDEST:
+            umplg_stdd_free(&q->items[q->head].d);
+            q->head = (q->head + 1) % q->depth;
+            q->count--;
+            q->dropped++;
+            break;
+
+        default:
+            while (q->count == q->depth && !UM_ATOMIC_GET(&sq->stopping)) {
+                pthread_cond_wait(&q->not_full, &q->mtx);
+            }
+            if (q->count == q->depth) {
+                pthread_mutex_unlock(&q->mtx);
+                return 2;
+            }
+            break;
+        }
+    }
+    // enqueue
+    struct umplg_sigq_item *it = &q->items[(q->head + q->count) % q->depth];
+    it->sh = tmp_shd;
+    sigq_stdd_copy(&it->d, d_in);
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->mtx);
+
+    return 0;
+}
+
+int
+umplg_proc_signal_async(umplg_mngr_t *pm, const char *s, umplg_data_std_t *d_in)
+{
+    // queue is not freed while producers are in-flight
+    UM_ATOMIC_ADD_F(&pm->sig_refs, 1);
+    int r = sigq_push(pm, s, d_in);
+    // last in-flight producer, wake up waiter
+    if (UM_ATOMIC_SUB_F(&pm->sig_refs, 1) == 0 && UM_ATOMIC_GET(&pm->sig_waiting)) {
+        pthread_mutex_lock(&pm->sig_mtx);
+        pthread_cond_broadcast(&pm->sig_idle);
+        pthread_mutex_unlock(&pm->sig_mtx);
+    }
+    return r;
 }
 
 umplg_mngr_t *
@@ -177,14 +583,17 @@ umplg_new_mngr()
     utarray_new(pm->plgs, &pd_icd);
     // init hooks hashmap
     pm->hooks = NULL;
+    // init hook dispatch table
+    memset(pm->hk_tbl, 0, sizeof(pm->hk_tbl));
     // init signals hashmap
     pm->signals = NULL;
-    // init cmd str/id map
-    pm->cmd_map = NULL;
-    // add mappings
-    add_cmd_id_map_item(UNKNWON_COMMAND, "UNKNWON_COMMAND", pm);
-    add_cmd_id_map_item(CMD_MQTT_PUBLISH, "CMD_MQTT_PUBLISH", pm);
-    add_cmd_id_map_item(CMD_LUA_CALL, "CMD_LUA_CALL", pm);
+    // async signal processing not started
+    pm->sigq = NULL;
+    pm->sig_refs = 0;
+    pm->sig_closed = 0;
+    pm->sig_waiting = 0;
+    pthread_mutex_init(&pm->sig_mtx, NULL);
+    pthread_cond_init(&pm->sig_idle, NULL);
     // pm pointer
     return pm;
 }
@@ -193,6 +602,14 @@ void
 umplg_free_mngr(umplg_mngr_t *pm)
 {
     umplgd_t *pd = NULL;
+    // stop accepting async signals (plugins are
+    // still running and might produce signals)
+    (void)UM_ATOMIC_COMP_SWAP(&pm->sig_closed, 0, 1);
+    // stop async signal processing
+    umplg_stop_async(pm);
+    // wait for producers running handlers
+    // synchronously (async not started)
+    sigq_wait_producers(pm);
     // free signals
     umplg_sh_t *c_sh = NULL;
     umplg_sh_t *tmp_sh = NULL;
@@ -216,15 +633,6 @@ umplg_free_mngr(umplg_mngr_t *pm)
         free(c_hk);
     }
 
-    // free mappings
-    umplg_cmd_map_t *c_cm = NULL;
-    umplg_cmd_map_t *tmp_cm = NULL;
-    HASH_ITER(hh, pm->cmd_map, c_cm, tmp_cm)
-    {
-        HASH_DEL(pm->cmd_map, c_cm);
-        free(c_cm);
-    }
-
     // free plugins
     for (pd = (umplgd_t *)utarray_front(pm->plgs); pd != NULL;
          pd = (umplgd_t *)utarray_next(pm->plgs, pd)) {
@@ -237,11 +645,59 @@ umplg_free_mngr(umplg_mngr_t *pm)
     }
     // freeplugin list
     utarray_free(pm->plgs);
+    pthread_cond_destroy(&pm->sig_idle);
+    pthread_mutex_destroy(&pm->sig_mtx);
 
     // free mngr
     free(pm);
 }
 
+/***********************/
+/* standard data arena */
+/***********************/
+// min size of heap allocated arena block
+#define STDD_BLK_SZ 1024
+// arena alignment (caller buffers are aligned
+// to this too, see umplg_stdd_init_buf)
+#define STDD_ALIGN _Alignof(max_align_t)
+
+// heap allocated arena block
+struct stdd_blk {
+    // next block
+    struct stdd_blk *next;
+    // block size
+    size_t sz;
+};
+// block header size (keeps block data aligned)
+#define STDD_BLK_HDR                                                       \
+    ((sizeof(struct stdd_blk) + STDD_ALIGN - 1) & ~((size_t)STDD_ALIGN - 1))
+
+static void *
+stdd_alloc(umplg_stdd_arena_t *a, size_t sz)
+{
+    // aligned offset
+    size_t off = (a->used + STDD_ALIGN - 1) & ~((size_t)STDD_ALIGN - 1);
+    // new block
+    if (a->buf == NULL || off + sz > a->sz) {
+        size_t bsz = (a->sz * 2 > STDD_BLK_SZ ? a->sz * 2 : STDD_BLK_SZ);
+        while (bsz < sz) {
+            bsz *= 2;
+        }
+        struct stdd_blk *b = malloc(STDD_BLK_HDR + bsz);
+        if (b == NULL) {
+            return NULL;
+        }
+        b->sz = bsz;
+        b->next = a->blks;
+        a->blks = b;
+        a->buf = (char *)b + STDD_BLK_HDR;
+        a->sz = bsz;
+        off = 0;
+    }
+    a->used = off + sz;
+    return a->buf + off;
+}
+
 static void
 std_items_copy(void *_dst, const void *_src)
 {
@@ -252,6 +708,11 @@ std_items_copy(void *_dst, const void *_src)
     umplg_data_std_item_t *s, *tmp, *n;
     // init hashmap to NULL
     dst->table = NULL;
+    // ordered columns
+    size_t sz = HASH_COUNT(src->table);
+    dst->cols = (sz > 0 ? malloc(sz * sizeof(umplg_data_std_item_t *)) : NULL);
+    dst->cols_n = 0;
+    dst->cols_cap = sz;
     // deep copy hash items
     HASH_ITER(hh, src->table, s, tmp)
     {
@@ -259,6 +720,7 @@ std_items_copy(void *_dst, const void *_src)
         n->name = strdup(s->name);
         n->value = strdup(s->value);
         HASH_ADD_KEYPTR(hh, dst->table, n->name, strlen(n->name), n);
+        dst->cols[dst->cols_n++] = n;
     }
 }
 
@@ -277,6 +739,11 @@ std_items_dtor(void *_elt)
         free(s->value);
         free(s);
     }
+    // free ordered columns
+    free(elt->cols);
+    elt->cols = NULL;
+    elt->cols_n = 0;
+    elt->cols_cap = 0;
 }
 
 void
@@ -303,10 +770,24 @@ void
 umplg_stdd_free(umplg_data_std_t *data)
 {
     // sanity check
-    if (data == NULL || data->items == NULL) {
+    if (data == NULL) {
         return;
     }
-    utarray_free(data->items);
+    if (data->items != NULL) {
+        utarray_free(data->items);
+        data->items = NULL;
+    }
+    // free arena blocks
+    struct stdd_blk *b = data->arena.blks;
+    while (b != NULL) {
+        struct stdd_blk *tmp = b->next;
+        free(b);
+        b = tmp;
+    }
+    memset(&data->arena, 0, sizeof(umplg_stdd_arena_t));
+    data->rows = NULL;
+    data->rows_n = 0;
+    data->rows_cap = 0;
 }
 
 int
@@ -336,16 +817,499 @@ umplg_stdd_item_add(umplg_data_std_items_t *items, umplg_data_std_item_t *item)
     }
     // add item
     HASH_ADD_KEYPTR(hh, items->table, item->name, strlen(item->name), item);
+    // invalidate column index
+    items->cols_n = 0;
 
     // success
     return 0;
 }
 
+int
+umplg_stdd_item_del(umplg_data_std_items_t *items, umplg_data_std_item_t *item)
+{
+    // sanity check
+    if (items == NULL || item == NULL) {
+        return 1;
+    }
+    // remove item (not freed)
+    HASH_DEL(items->table, item);
+    // invalidate column index
+    items->cols_n = 0;
+
+    // success
+    return 0;
+}
+
+void
+umplg_stdd_init_buf(umplg_data_std_t *data, void *buf, size_t sz)
+{
+    // sanity check
+    if (data == NULL) {
+        return;
+    }
+    // align base address (caller buffers are
+    // usually plain char arrays on stack)
+    if (buf != NULL) {
+        uintptr_t a = ((uintptr_t)buf + STDD_ALIGN - 1) &
+                      ~((uintptr_t)STDD_ALIGN - 1);
+        size_t pad = a - (uintptr_t)buf;
+        buf = (pad < sz ? (void *)a : NULL);
+        sz = (pad < sz ? sz - pad : 0);
+    }
+    data->arena.buf = buf;
+    data->arena.sz = (buf != NULL ? sz : 0);
+    data->arena.used = 0;
+}
+
+umplg_data_std_item_t *
+umplg_stdd_item_at(umplg_data_std_items_t *items, size_t i)
+{
+    // sanity check
+    if (items == NULL) {
+        return NULL;
+    }
+    size_t sz = HASH_COUNT(items->table);
+    if (sz == 0) {
+        return NULL;
+    }
+    // (re)build column index if invalidated or if it
+    // does not match hashmap (count and last item)
+    UT_hash_table *tbl = items->table->hh.tbl;
+    if (items->cols_n != sz || items->cols[sz - 1] != ELMT_FROM_HH(tbl, tbl->tail)) {
+        if (items->cols_cap < sz) {
+            umplg_data_std_item_t **cols =
+                realloc(items->cols, sz * sizeof(umplg_data_std_item_t *));
+            if (cols == NULL) {
+                return NULL;
+            }
+            items->cols = cols;
+            items->cols_cap = sz;
+        }
+        items->cols_n = 0;
+        umplg_data_std_item_t *item = NULL;
+        for (item = items->table; item != NULL; item = item->hh.next) {
+            items->cols[items->cols_n++] = item;
+        }
+    }
+    // column at index
+    if (i >= items->cols_n) {
+        return NULL;
+    }
+    return items->cols[i];
+}
+
+umplg_data_std_item_t *
+umplg_stdd_item_find(umplg_data_std_items_t *items, const char *name)
+{
+    // sanity check
+    if (items == NULL || name == NULL) {
+        return NULL;
+    }
+    umplg_data_std_item_t *item = NULL;
+    HASH_FIND_STR(items->table, name, item);
+    return item;
+}
+
+umplg_stdd_row_t *
+umplg_stdd_row_new(umplg_data_std_t *data, size_t cols)
+{
+    // sanity check
+    if (data == NULL) {
+        return NULL;
+    }
+    // grow row list
+    if (data->rows_n == data->rows_cap) {
+        size_t cap = (data->rows_cap > 0 ? data->rows_cap * 2 : 4);
+        umplg_stdd_row_t *rows = stdd_alloc(&data->arena, cap * sizeof(umplg_stdd_row_t));
+        if (rows == NULL) {
+            return NULL;
+        }
+        if (data->rows_n > 0) {
+            memcpy(rows, data->rows, data->rows_n * sizeof(umplg_stdd_row_t));
+        }
+        data->rows = rows;
+        data->rows_cap = cap;
+    }
+    // new row
+    umplg_stdd_row_t *row = &data->rows[data->rows_n];
+    row->n = 0;
+    row->cap = (cols > 0 ? cols : 4);
+    row->cols = stdd_alloc(&data->arena, row->cap * sizeof(umplg_stdd_col_t));
+    if (row->cols == NULL) {
+        return NULL;
+    }
+    data->rows_n++;
+    return row;
+}
+
+static umplg_stdd_col_t *
+stdd_col_new(umplg_data_std_t *data,
+             umplg_stdd_row_t *row,
+             const char *name,
+             enum umplg_stdd_type_t type)
+{
+    // sanity check
+    if (data == NULL || row == NULL) {
+        return NULL;
+    }
+    // grow column list
+    if (row->n == row->cap) {
+        size_t cap = row->cap * 2;
+        umplg_stdd_col_t *cols = stdd_alloc(&data->arena, cap * sizeof(umplg_stdd_col_t));
+        if (cols == NULL) {
+            return NULL;
+        }
+        memcpy(cols, row->cols, row->n * sizeof(umplg_stdd_col_t));
+        row->cols = cols;
+        row->cap = cap;
+    }
+    // add column
+    umplg_stdd_col_t *c = &row->cols[row->n++];
+    c->name = (name != NULL ? name : "");
+    c->value = "";
+    c->sz = 0;
+    c->type = type;
+    c->num.i = 0;
+    return c;
+}
+
+int
+umplg_stdd_col_add(umplg_data_std_t *data,
+                   umplg_stdd_row_t *row,
+                   const char *name,
+                   const char *value,
+                   size_t sz)
+{
+    umplg_stdd_col_t *c = stdd_col_new(data, row, name, UMPLG_STDD_STR);
+    if (c == NULL) {
+        return (data == NULL || row == NULL ? 1 : 2);
+    }
+    if (value != NULL) {
+        c->value = value;
+        c->sz = sz;
+    }
+
+    // success
+    return 0;
+}
+
+int
+umplg_stdd_col_add_blob(umplg_data_std_t *data,
+                        umplg_stdd_row_t *row,
+                        const char *name,
+                        const void *v,
+                        size_t sz)
+{
+    if (umplg_stdd_col_add(data, row, name, v, sz)) {
+        return (data == NULL || row == NULL ? 1 : 2);
+    }
+    row->cols[row->n - 1].type = UMPLG_STDD_BLOB;
+    return 0;
+}
+
+int
+umplg_stdd_col_add_int(umplg_data_std_t *data,
+                       umplg_stdd_row_t *row,
+                       const char *name,
+                       int64_t v)
+{
+    umplg_stdd_col_t *c = stdd_col_new(data, row, name, UMPLG_STDD_INT);
+    if (c == NULL) {
+        return (data == NULL || row == NULL ? 1 : 2);
+    }
+    c->num.i = v;
+    return 0;
+}
+
+int
+umplg_stdd_col_add_dbl(umplg_data_std_t *data,
+                       umplg_stdd_row_t *row,
+                       const char *name,
+                       double v)
+{
+    umplg_stdd_col_t *c = stdd_col_new(data, row, name, UMPLG_STDD_DBL);
+    if (c == NULL) {
+        return (data == NULL || row == NULL ? 1 : 2);
+    }
+    c->num.d = v;
+    return 0;
+}
+
+int
+umplg_stdd_col_add_bool(umplg_data_std_t *data,
+                        umplg_stdd_row_t *row,
+                        const char *name,
+                        bool v)
+{
+    umplg_stdd_col_t *c = stdd_col_new(data, row, name, UMPLG_STDD_BOOL);
+    if (c == NULL) {
+        return (data == NULL || row == NULL ? 1 : 2);
+    }
+    c->num.b = v;
+    return 0;
+}
+
+int64_t
+umplg_stdd_col_int(const umplg_stdd_col_t *col)
+{
+    if (col == NULL) {
+        return 0;
+    }
+    switch (col->type) {
+    case UMPLG_STDD_INT:
+        return col->num.i;
+    case UMPLG_STDD_DBL:
+        return (int64_t)col->num.d;
+    case UMPLG_STDD_BOOL:
+        return col->num.b;
+    default:
+        break;
+    }
+    // string value (might not be NUL terminated)
+    char b[32];
+    size_t sz = (col->sz < sizeof(b) ? col->sz : sizeof(b) - 1);
+    memcpy(b, col->value, sz);
+    b[sz] = '\0';
+    return strtoll(b, NULL, 10);
+}
+
+double
+umplg_stdd_col_dbl(const umplg_stdd_col_t *col)
+{
+    if (col == NULL) {
+        return 0;
+    }
+    switch (col->type) {
+    case UMPLG_STDD_INT:
+        return (double)col->num.i;
+    case UMPLG_STDD_DBL:
+        return col->num.d;
+    case UMPLG_STDD_BOOL:
+        return col->num.b;
+    default:
+        break;
+    }
+    // string value (might not be NUL terminated)
+    char b[64];
+    size_t sz = (col->sz < sizeof(b) ? col->sz : sizeof(b) - 1);
+    memcpy(b, col->value, sz);
+    b[sz] = '\0';
+    return strtod(b, NULL);
+}
+
+bool
+umplg_stdd_col_bool(const umplg_stdd_col_t *col)
+{
+    if (col == NULL) {
+        return false;
+    }
+    switch (col->type) {
+    case UMPLG_STDD_INT:
+        return col->num.i != 0;
+    case UMPLG_STDD_DBL:
+        return col->num.d != 0;
+    case UMPLG_STDD_BOOL:
+        return col->num.b;
+    default:
+        break;
+    }
+    // "true" or non-zero number
+    if (col->sz == 4 && strncasecmp(col->value, "true", 4) == 0) {
+        return true;
+    }
+    return umplg_stdd_col_int(col) != 0;
+}
+
+const char *
+umplg_stdd_col_str(const umplg_stdd_col_t *col, char *buf, size_t sz)
+{
+    if (col == NULL) {
+        return "";
+    }
+    switch (col->type) {
+    case UMPLG_STDD_INT:
+        snprintf(buf, sz, "%" PRId64, col->num.i);
+        return buf;
+    // same format as lua tostring
+    case UMPLG_STDD_DBL:
+        snprintf(buf, sz, "%.14g", col->num.d);
+        return buf;
+    // same format as lua tostring
+    case UMPLG_STDD_BOOL:
+        return (col->num.b ? "true" : "false");
+    default:
+        break;
+    }
+    return col->value;
+}
+
+int
+umplg_stdd_col_add_copy(umplg_data_std_t *data,
+                        umplg_stdd_row_t *row,
+                        const char *name,
+                        const char *value,
+                        size_t sz)
+{
+    // sanity check
+    if (data == NULL || row == NULL) {
+        return 1;
+    }
+    // copy name and value (NUL terminated)
+    size_t n_sz = (name != NULL ? strlen(name) : 0);
+    size_t v_sz = (value != NULL ? sz : 0);
+    char *b = stdd_alloc(&data->arena, n_sz + v_sz + 2);
+    if (b == NULL) {
+        return 2;
+    }
+    memcpy(b, (name != NULL ? name : ""), n_sz);
+    b[n_sz] = '\0';
+    memcpy(&b[n_sz + 1], (value != NULL ? value : ""), v_sz);
+    b[n_sz + v_sz + 1] = '\0';
+
+    return umplg_stdd_col_add(data, row, b, &b[n_sz + 1], v_sz);
+}
+
+size_t
+umplg_stdd_rows(umplg_data_std_t *data)
+{
+    // sanity check
+    if (data == NULL) {
+        return 0;
+    }
+    size_t sz = (data->items != NULL ? utarray_len(data->items) : 0);
+    return sz + data->rows_n;
+}
+
+size_t
+umplg_stdd_row_sz(umplg_data_std_t *data, size_t r)
+{
+    // sanity check
+    if (data == NULL) {
+        return 0;
+    }
+    // hashmap rows
+    size_t l_sz = (data->items != NULL ? utarray_len(data->items) : 0);
+    if (r < l_sz) {
+        umplg_data_std_items_t *items = utarray_eltptr(data->items, r);
+        return HASH_COUNT(items->table);
+    }
+    // zero-copy rows
+    r -= l_sz;
+    if (r < data->rows_n) {
+        return data->rows[r].n;
+    }
+    return 0;
+}
+
+int
+umplg_stdd_col_get(umplg_data_std_t *data, size_t r, size_t c, umplg_stdd_col_t *col)
+{
+    // sanity check
+    if (data == NULL || col == NULL) {
+        return 1;
+    }
+    // hashmap rows
+    size_t l_sz = (data->items != NULL ? utarray_len(data->items) : 0);
+    if (r < l_sz) {
+        umplg_data_std_items_t *items = utarray_eltptr(data->items, r);
+        umplg_data_std_item_t *item = umplg_stdd_item_at(items, c);
+        if (item == NULL) {
+            return 2;
+        }
+        col->name = item->name;
+        col->value = (item->value != NULL ? item->value : "");
+        col->sz = (item->value != NULL ? strlen(item->value) : 0);
+        col->type = UMPLG_STDD_STR;
+        col->num.i = 0;
+        return 0;
+    }
+    // zero-copy rows
+    r -= l_sz;
+    if (r >= data->rows_n || c >= data->rows[r].n) {
+        return 2;
+    }
+    *col = data->rows[r].cols[c];
+    return 0;
+}
+
+int
+umplg_stdd_col_get_str(umplg_data_std_t *data,
+                       size_t r,
+                       size_t c,
+                       umplg_stdd_col_t *col)
+{
+    if (umplg_stdd_col_get(data, r, c, col)) {
+        return 1;
+    }
+    // hashmap values are NUL terminated
+    if (r < (data->items != NULL ? utarray_len(data->items) : 0)) {
+        return 0;
+    }
+    // zero-copy values are not (e.g. payloads)
+    char nb[32];
+    const char *v = umplg_stdd_col_str(col, nb, sizeof(nb));
+    size_t sz = (v == nb ? strlen(nb) : col->sz);
+    if (v == NULL) {
+        v = "";
+        sz = 0;
+    }
+    char *b = stdd_alloc(&data->arena, sz + 1);
+    if (b == NULL) {
+        return 2;
+    }
+    memcpy(b, v, sz);
+    b[sz] = '\0';
+    col->value = b;
+    col->sz = sz;
+    return 0;
+}
+
+void
+umplg_stdd_legacy(umplg_data_std_t *data)
+{
+    // sanity check
+    if (data == NULL || data->rows_n == 0) {
+        return;
+    }
+    umplg_stdd_init(data);
+    // convert rows
+    for (size_t i = 0; i < data->rows_n; i++) {
+        umplg_stdd_row_t *row = &data->rows[i];
+        // new row (in-place, no copy)
+        utarray_extend_back(data->items);
+        umplg_data_std_items_t *items = utarray_back(data->items);
+        items->table = NULL;
+        items->cols = (row->n > 0 ? malloc(row->n * sizeof(umplg_data_std_item_t *)) : NULL);
+        items->cols_n = 0;
+        items->cols_cap = row->n;
+        for (size_t j = 0; j < row->n; j++) {
+            umplg_stdd_col_t *c = &row->cols[j];
+            umplg_data_std_item_t *n = malloc(sizeof(umplg_data_std_item_t));
+            n->name = strdup(c->name);
+            if (c->type == UMPLG_STDD_STR || c->type == UMPLG_STDD_BLOB) {
+                n->value = strndup(c->value, c->sz);
+            } else {
+                // typed values are converted to strings
+                char b[32];
+                n->value = strdup(umplg_stdd_col_str(c, b, sizeof(b)));
+            }
+            HASH_ADD_KEYPTR(hh, items->table, n->name, strlen(n->name), n);
+            items->cols[items->cols_n++] = n;
+        }
+    }
+    // rows moved to hashmaps
+    data->rows_n = 0;
+}
+
 int
 umplg_get_cmd_id(umplg_mngr_t *pm, const char *cmd_str)
 {
-    umplg_cmd_map_t *cmd = NULL;
-    HASH_FIND_STR(pm->cmd_map, cmd_str, cmd);
+    // sanity check
+    if (cmd_str == NULL) {
+        return -1;
+    }
+    // perfect hash lookup (gperf)
+    const umplg_cmd_map_t *cmd = umplg_cmd_lookup(cmd_str, strlen(cmd_str));
     // id found
     if (cmd != NULL) {
         return cmd->id;
@@ -0,0 +1,281 @@
+/*
+ *               _____  ____ __
+ *   __ ____ _  /  _/ |/ / //_/
+ *  / // /  ' \_/ //    / ,<
+ *  \_,_/_/_/_/___/_/|_/_/|_|
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include <umtopic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uthash.h>
+#include <utarray.h>
+
+/*************/
+/* Trie node */
+/*************/
+struct umtopic_node {
+    // topic level
+    char *level;
+    // exact level children
+    umtopic_node_t *children;
+    // '+' child
+    umtopic_node_t *plus;
+    // '#' child
+    umtopic_node_t *hash;
+    // values of filters ending at this node
+    UT_array *vals;
+    // hashable
+    UT_hash_handle hh;
+};
+
+static umtopic_node_t *
+node_new(const char *level, size_t sz)
+{
+    umtopic_node_t *n = calloc(1, sizeof(umtopic_node_t));
+    if (n == NULL) {
+        return NULL;
+    }
+    n->level = strndup(level, sz);
+    if (n->level == NULL) {
+        free(n);
+        return NULL;
+    }
+    return n;
+}
+
+static void
+node_free(umtopic_node_t *n)
+{
+    if (n == NULL) {
+        return;
+    }
+    umtopic_node_t *c, *tmp;
+    HASH_ITER(hh, n->children, c, tmp)
+    {
+        HASH_DEL(n->children, c);
+        node_free(c);
+    }
+    node_free(n->plus);
+    node_free(n->hash);
+    if (n->vals != NULL) {
+        utarray_free(n->vals);
+    }
+    free(n->level);
+    free(n);
+}
+
+static size_t
+node_report(umtopic_node_t *n, umtopic_match_cb_t cb, void *arg)
+{
+    if (n->vals == NULL) {
+        return 0;
+    }
+    void **v = NULL;
+    while ((v = utarray_next(n->vals, v))) {
+        cb(*v, arg);
+    }
+    return utarray_len(n->vals);
+}
+
+// match context
+struct match_ctx {
+    // topic end
+    const char *e;
+    // level substitutions
+    const umtopic_subst_t *subst;
+    size_t subst_n;
+    // callback
+    umtopic_match_cb_t cb;
+    void *arg;
+};
+
+static size_t
+node_match(umtopic_node_t *n, const char *p, bool first, struct match_ctx *ctx)
+{
+    // end of topic (filter ends here, or
+    // parent level of 'a/#' filter)
+    if (p == NULL) {
+        size_t m = node_report(n, ctx->cb, ctx->arg);
+        if (n->hash != NULL) {
+            m += node_report(n->hash, ctx->cb, ctx->arg);
+        }
+        return m;
+    }
+    const char *e = ctx->e;
+    // current level
+    const char *l_e = memchr(p, '/', e - p);
+    size_t l_sz = (l_e != NULL ? l_e - p : e - p);
+    const char *next = (l_e != NULL ? l_e + 1 : NULL);
+    size_t m = 0;
+    // wildcards do not match '$' topics at first level
+    if (!(first && l_sz > 0 && p[0] == '$')) {
+        if (n->hash != NULL) {
+            m += node_report(n->hash, ctx->cb, ctx->arg);
+        }
+        if (n->plus != NULL) {
+            m += node_match(n->plus, next, false, ctx);
+        }
+    }
+    // exact level (substitution keys are placeholders
+    // and do not match topic level literally, e.g.
+    // topic level '%u' does not match filter level '%u')
+    bool is_key = false;
+    for (size_t i = 0; i < ctx->subst_n && !is_key; i++) {
+        const char *k = ctx->subst[i].key;
+        is_key = (k != NULL && strlen(k) == l_sz && memcmp(k, p, l_sz) == 0);
+    }
+    umtopic_node_t *c = NULL;
+    if (!is_key) {
+        HASH_FIND(hh, n->children, p, l_sz, c);
+    }
+    if (c != NULL) {
+        m += node_match(c, next, false, ctx);
+    }
+    // substituted levels (e.g. '%u' level
+    // matches username)
+    for (size_t i = 0; i < ctx->subst_n; i++) {
+        const umtopic_subst_t *s = &ctx->subst[i];
+        if (s->val == NULL || strlen(s->val) != l_sz || memcmp(s->val, p, l_sz) != 0) {
+            continue;
+        }
+        c = NULL;
+        HASH_FIND(hh, n->children, s->key, strlen(s->key), c);
+        if (c != NULL) {
+            m += node_match(c, next, false, ctx);
+        }
+    }
+    return m;
+}
+
+umtopic_trie_t *
+umtopic_new(void)
+{
+    umtopic_trie_t *t = calloc(1, sizeof(umtopic_trie_t));
+    if (t == NULL) {
+        return NULL;
+    }
+    t->root = node_new("", 0);
+    if (t->root == NULL) {
+        free(t);
+        return NULL;
+    }
+    return t;
+}
+
+void
+umtopic_free(umtopic_trie_t *t)
+{
+    if (t == NULL) {
+        return;
+    }
+    node_free(t->root);
+    free(t);
+}
+
+bool
+umtopic_filter_valid(const char *filter)
+{
+    if (filter == NULL || filter[0] == '\0') {
+        return false;
+    }
+    for (const char *p = filter; *p != '\0'; p++) {
+        // wildcards must occupy an entire level
+        if (*p == '+' || *p == '#') {
+            if (p != filter && p[-1] != '/') {
+                return false;
+            }
+            if (p[1] != '\0' && p[1] != '/') {
+                return false;
+            }
+            // '#' must be the last level
+            if (*p == '#' && p[1] != '\0') {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int
+umtopic_add(umtopic_trie_t *t, const char *filter, void *val)
+{
+    // sanity check
+    if (t == NULL || !umtopic_filter_valid(filter)) {
+        return 1;
+    }
+    umtopic_node_t *n = t->root;
+    const char *p = filter;
+    const char *e = filter + strlen(filter);
+    // walk/create levels
+    while (p != NULL) {
+        const char *l_e = memchr(p, '/', e - p);
+        size_t l_sz = (l_e != NULL ? l_e - p : e - p);
+        umtopic_node_t **w = NULL;
+        umtopic_node_t *c = NULL;
+        if (l_sz == 1 && p[0] == '+') {
+            w = &n->plus;
+        } else if (l_sz == 1 && p[0] == '#') {
+            w = &n->hash;
+        }
+        // wildcard level
+        if (w != NULL) {
+            if (*w == NULL) {
+                *w = node_new(p, l_sz);
+            }
+            c = *w;
+
+            // exact level
+        } else {
+            HASH_FIND(hh, n->children, p, l_sz, c);
+            if (c == NULL) {
+                c = node_new(p, l_sz);
+                if (c != NULL) {
+                    HASH_ADD_KEYPTR(hh, n->children, c->level, l_sz, c);
+                }
+            }
+        }
+        if (c == NULL) {
+            return 2;
+        }
+        n = c;
+        p = (l_e != NULL ? l_e + 1 : NULL);
+    }
+    // attach value
+    if (n->vals == NULL) {
+        utarray_new(n->vals, &ut_ptr_icd);
+    }
+    utarray_push_back(n->vals, &val);
+    t->n++;
+    return 0;
+}
+
+size_t
+umtopic_match(umtopic_trie_t *t,
+              const char *topic,
+              size_t sz,
+              umtopic_match_cb_t cb,
+              void *arg)
+{
+    return umtopic_match_subst(t, topic, sz, NULL, 0, cb, arg);
+}
+
+size_t
+umtopic_match_subst(umtopic_trie_t *t,
+                    const char *topic,
+                    size_t sz,
+                    const umtopic_subst_t *subst,
+                    size_t subst_n,
+                    umtopic_match_cb_t cb,
+                    void *arg)
+{
+    // sanity check
+    if (t == NULL || topic == NULL || cb == NULL || t->n == 0) {
+        return 0;
+    }
+    struct match_ctx ctx = { topic + sz, subst, subst_n, cb, arg };
+    return node_match(t->root, topic, true, &ctx);
+}
@@ -0,0 +1,190 @@
+/*
+ *               _____  ____ __
+ *   __ ____ _  /  _/ |/ / //_/
+ *  / // /  ' \_/ //    / ,<
+ *  \_,_/_/_/_/___/_/|_/_/|_|
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include <umtwheel.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+// slot index at level
+#define UMTW_IDX(t, l) (((t) >> ((l) * UMTW_LVL_BITS)) & (UMTW_LVL_SZ - 1))
+
+/**************/
+/* Slot lists */
+/**************/
+static void
+slot_init(umtw_timer_t *h)
+{
+    h->next = h;
+    h->prev = h;
+}
+
+static bool
+slot_empty(umtw_timer_t *h)
+{
+    return h->next == h;
+}
+
+static void
+slot_push(umtw_timer_t *h, umtw_timer_t *t)
+{
+    t->prev = h->prev;
+    t->next = h;
+    h->prev->next = t;
+    h->prev = t;
+}
+
+// detach all timers from slot (h2 becomes list head)
+static void
+slot_move(umtw_timer_t *h, umtw_timer_t *h2)
+{
+    slot_init(h2);
+    if (slot_empty(h)) {
+        return;
+    }
+    h2->next = h->next;
+    h2->prev = h->prev;
+    h2->next->prev = h2;
+    h2->prev->next = h2;
+    slot_init(h);
+}
+
+static void
+timer_unlink(umtw_timer_t *t)
+{
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->next = NULL;
+    t->prev = NULL;
+}
+
+// place timer in slot (relative to current tick, current
+// tick slot is only valid while cascading)
+static void
+timer_place(umtw_t *tw, umtw_timer_t *t, uint64_t min)
+{
+    uint64_t e = (t->expires > min ? t->expires : min);
+    uint64_t d = e - tw->now;
+    int l = 0;
+    while (l < UMTW_LVLS - 1 && d >= (1ULL << ((l + 1) * UMTW_LVL_BITS))) {
+        l++;
+    }
+    // out of range, park at the furthest slot
+    // of top level (cascaded again)
+    if (d >= (1ULL << (UMTW_LVLS * UMTW_LVL_BITS))) {
+        e = tw->now + (1ULL << (UMTW_LVLS * UMTW_LVL_BITS)) - 1;
+    }
+    slot_push(&tw->slots[l][UMTW_IDX(e, l)], t);
+}
+
+// move timers of level slot to lower levels
+static int
+cascade(umtw_t *tw, int l)
+{
+    int idx = UMTW_IDX(tw->now, l);
+    umtw_timer_t h;
+    slot_move(&tw->slots[l][idx], &h);
+    while (!slot_empty(&h)) {
+        umtw_timer_t *t = h.next;
+        timer_unlink(t);
+        timer_place(tw, t, tw->now);
+    }
+    return idx;
+}
+
+umtw_t *
+umtw_new(uint64_t now)
+{
+    umtw_t *tw = calloc(1, sizeof(umtw_t));
+    if (tw == NULL) {
+        return NULL;
+    }
+    tw->now = now;
+    for (int l = 0; l < UMTW_LVLS; l++) {
+        for (int i = 0; i < UMTW_LVL_SZ; i++) {
+            slot_init(&tw->slots[l][i]);
+        }
+    }
+    return tw;
+}
+
+void
+umtw_free(umtw_t *tw)
+{
+    free(tw);
+}
+
+void
+umtw_add(umtw_t *tw, umtw_timer_t *t, uint64_t expires)
+{
+    if (tw == NULL || t == NULL) {
+        return;
+    }
+    umtw_del(tw, t);
+    t->expires = expires;
+    timer_place(tw, t, tw->now + 1);
+    tw->n++;
+}
+
+void
+umtw_del(umtw_t *tw, umtw_timer_t *t)
+{
+    if (tw == NULL || t == NULL || t->next == NULL) {
+        return;
+    }
+    timer_unlink(t);
+    tw->n--;
+}
+
+size_t
+umtw_advance(umtw_t *tw, uint64_t now, umtw_cb_t cb, void *arg)
+{
+    if (tw == NULL || cb == NULL) {
+        return 0;
+    }
+    size_t m = 0;
+    while (tw->now < now) {
+        tw->now++;
+        // cascade higher levels on level wrap
+        for (int l = 1; l < UMTW_LVLS && UMTW_IDX(tw->now, l - 1) == 0; l++) {
+            if (cascade(tw, l) != 0) {
+                break;
+            }
+        }
+        // fire current slot (callback can
+        // re-add timers)
+        umtw_timer_t h;
+        slot_move(&tw->slots[0][UMTW_IDX(tw->now, 0)], &h);
+        while (!slot_empty(&h)) {
+            umtw_timer_t *t = h.next;
+            timer_unlink(t);
+            tw->n--;
+            m++;
+            cb(t, arg);
+        }
+        // nothing left, skip ahead
+        if (tw->n == 0) {
+            tw->now = now;
+        }
+    }
+    return m;
+}
+
+uint64_t
+umtw_next(umtw_t *tw)
+{
+    for (uint64_t i = 1; i < UMTW_LVL_SZ; i++) {
+        uint64_t t = tw->now + i;
+        // level 0 wrap, cascade
+        if (UMTW_IDX(t, 0) == 0 || !slot_empty(&tw->slots[0][UMTW_IDX(t, 0)])) {
+            return i;
+        }
+    }
+    return UMTW_LVL_SZ;
+}
@@ -0,0 +1,112 @@
+/*
+ *               _____  ____ __
+ *   __ ____ _  /  _/ |/ / //_/
+ *  / // /  ' \_/ //    / ,<
+ *  \_,_/_/_/_/___/_/|_/_/|_|
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+// ACL rule evaluation (static functions of the
+// mosquitto auth plugin, broker API is stubbed)
+#include "../src/services/sysagent/plugins/mosquitto_auth/plg_mosquitto_auth.c"
+
+// number of failed checks
+static int fails = 0;
+
+#define CHECK(expr)                                                    \
+    do {                                                               \
+        if (!(expr)) {                                                 \
+            printf("FAIL: %s:%d: %s\n", __FILE__, __LINE__, #expr);    \
+            fails++;                                                   \
+        }                                                              \
+    } while (0)
+
+// broker API stubs
+void
+mosquitto_log_printf(int level, const char *fmt, ...)
+{
+}
+
+const char *
+mosquitto_client_id(const struct mosquitto *client)
+{
+    return NULL;
+}
+
+const char *
+mosquitto_client_username(const struct mosquitto *client)
+{
+    return NULL;
+}
+
+int
+mosquitto_callback_register(mosquitto_plugin_id_t *identifier,
+                            int event,
+                            MOSQ_FUNC_generic_callback cb,
+                            const void *event_data,
+                            void *userdata)
+{
+    return MOSQ_ERR_SUCCESS;
+}
+
+int
+mosquitto_callback_unregister(mosquitto_plugin_id_t *identifier,
+                              int event,
+                              MOSQ_FUNC_generic_callback cb,
+                              const void *event_data)
+{
+    return MOSQ_ERR_SUCCESS;
+}
+
+// add rule (username, flags, topic, access)
+static void
+rule(struct acl_rules *a, const char *usr, int flags, const char *topic, int access)
+{
+    umdb_acl_d_t r = { .usr = usr, .flags = flags, .topic = topic, .access = access };
+    CHECK(acl_rules_add(&r, a) == 0);
+}
+
+// decide as user "alice", client "c1"
+static int
+decide(struct acl_rules *a, int access, const char *topic)
+{
+    return acl_decide(a, "alice", "c1", 1, 0, access, topic);
+}
+
+int
+main(int argc, char **argv)
+{
+    struct acl_rules *a = acl_rules_new();
+    CHECK(a != NULL);
+    // umdb default access (READ | WRITE)
+    rule(a, "alice", -1, "devices/%u/#", MOSQ_ACL_READ | MOSQ_ACL_WRITE);
+    rule(a, NULL, -1, "public/#", MOSQ_ACL_READ);
+    rule(a, NULL, -1, "upload/#", MOSQ_ACL_WRITE);
+
+    // read grant covers subscribe
+    CHECK(decide(a, MOSQ_ACL_SUBSCRIBE, "devices/alice/#") == MOSQ_ERR_SUCCESS);
+    CHECK(decide(a, MOSQ_ACL_SUBSCRIBE, "public/news") == MOSQ_ERR_SUCCESS);
+    CHECK(decide(a, MOSQ_ACL_READ, "public/news") == MOSQ_ERR_SUCCESS);
+    CHECK(decide(a, MOSQ_ACL_WRITE, "public/news") == MOSQ_ERR_ACL_DENIED);
+
+    // write-only grant does not cover subscribe
+    CHECK(decide(a, MOSQ_ACL_WRITE, "upload/file") == MOSQ_ERR_SUCCESS);
+    CHECK(decide(a, MOSQ_ACL_SUBSCRIBE, "upload/file") == MOSQ_ERR_ACL_DENIED);
+    CHECK(decide(a, MOSQ_ACL_READ, "upload/file") == MOSQ_ERR_ACL_DENIED);
+
+    // no matching rule
+    CHECK(decide(a, MOSQ_ACL_SUBSCRIBE, "devices/bob/#") == MOSQ_ERR_ACL_DENIED);
+
+    // unknown user
+    CHECK(acl_decide(a, "alice", "c1", -1, 0, MOSQ_ACL_SUBSCRIBE, "public/news") ==
+          MOSQ_ERR_ACL_DENIED);
+
+    acl_rules_free(a);
+    if (fails > 0) {
+        return EXIT_FAILURE;
+    }
+    printf("%s\n", "acl: OK");
+    return EXIT_SUCCESS;
+}
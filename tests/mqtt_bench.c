@@ -0,0 +1,250 @@
+/*
+ *               _____  ____ __
+ *   __ ____ _  /  _/ |/ / //_/
+ *  / // /  ' \_/ //    / ,<
+ *  \_,_/_/_/_/___/_/|_/_/|_|
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <MQTTAsync.h>
+#include <umatomic.h>
+
+// QoS/in-flight matrix (local broker, default payload):
+//   mqtt_bench -q 0
+//   for i in 10 100 1000; do mqtt_bench -q 1 -i $i; done
+
+// defaults
+#define BENCH_ADDR  "tcp://localhost:1883"
+#define BENCH_TOPIC "mink/bench"
+#define BENCH_MSGS  100000
+#define BENCH_SZ    64
+// connect/complete timeout (s)
+#define BENCH_TIMEOUT 60
+
+// bench state (updated from paho threads)
+struct bench {
+    uint32_t connected;
+    uint32_t failed;
+    uint32_t acked;
+};
+
+static double
+bench_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+on_connect(void *ctx, MQTTAsync_successData *resp)
+{
+    struct bench *b = ctx;
+    UM_ATOMIC_COMP_SWAP(&b->connected, 0, 1);
+}
+
+static void
+on_connect_fail(void *ctx, MQTTAsync_failureData *resp)
+{
+    struct bench *b = ctx;
+    UM_ATOMIC_ADD_F(&b->failed, 1);
+}
+
+// QoS1/2 message completed
+static void
+on_send(void *ctx, MQTTAsync_successData *resp)
+{
+    struct bench *b = ctx;
+    UM_ATOMIC_ADD_F(&b->acked, 1);
+}
+
+static void
+on_send_fail(void *ctx, MQTTAsync_failureData *resp)
+{
+    struct bench *b = ctx;
+    UM_ATOMIC_ADD_F(&b->failed, 1);
+    UM_ATOMIC_ADD_F(&b->acked, 1);
+}
+
+// number of pending tokens (QoS0 completion)
+static int
+bench_pending(MQTTAsync client)
+{
+    MQTTAsync_token *tokens = NULL;
+    int n = 0;
+    if (MQTTAsync_getPendingTokens(client, &tokens) == MQTTASYNC_SUCCESS &&
+        tokens != NULL) {
+        while (tokens[n] != -1) {
+            n++;
+        }
+        MQTTAsync_free(tokens);
+    }
+    return n;
+}
+
+// help
+static void
+print_help()
+{
+    printf("%s\n\nOptions:\n", "mqtt_bench - MQTT publish throughput (plg_mqtt publish path)");
+    printf(" %s\n %s\n %s\n %s\n %s\n %s\n %s\n %s\n",
+           "-?    help",
+           "-a    broker address (default " BENCH_ADDR ")",
+           "-t    topic (default " BENCH_TOPIC ")",
+           "-q    QoS (0 - 2, default 1)",
+           "-i    max_inflight (default = client default)",
+           "-n    number of messages",
+           "-s    payload size",
+           "-u/-p username/password");
+}
+
+// main; publishes messages the same way as plg_mqtt
+// (MQTTAsync_send, QoS0 without response options) and
+// reports messages/s until all messages are completed
+int
+main(int argc, char **argv)
+{
+    const char *addr = BENCH_ADDR;
+    const char *topic = BENCH_TOPIC;
+    const char *usr = NULL;
+    const char *pwd = NULL;
+    int qos = 1;
+    int max_inflight = 0;
+    int n = BENCH_MSGS;
+    int sz = BENCH_SZ;
+    int opt;
+
+    // get args
+    while ((opt = getopt(argc, argv, "?a:t:q:i:n:s:u:p:")) != -1) {
+        switch (opt) {
+        case 'a':
+            addr = optarg;
+            break;
+        case 't':
+            topic = optarg;
+            break;
+        case 'q':
+            qos = atoi(optarg);
+            break;
+        case 'i':
+            max_inflight = atoi(optarg);
+            break;
+        case 'n':
+            n = atoi(optarg);
+            break;
+        case 's':
+            sz = atoi(optarg);
+            break;
+        case 'u':
+            usr = optarg;
+            break;
+        case 'p':
+            pwd = optarg;
+            break;
+        default:
+            print_help();
+            return 1;
+        }
+    }
+    if (qos < 0 || qos > 2 || n < 1 || sz < 0 || max_inflight < 0) {
+        print_help();
+        return 1;
+    }
+
+    // connect
+    struct bench b = { 0 };
+    MQTTAsync client;
+    if (MQTTAsync_create(&client, addr, "mink_bench", MQTTCLIENT_PERSISTENCE_NONE, NULL) !=
+        MQTTASYNC_SUCCESS) {
+        printf("%s\n", "ERROR: Cannot create client");
+        return 1;
+    }
+    MQTTAsync_connectOptions conn_opts = MQTTAsync_connectOptions_initializer;
+    conn_opts.keepAliveInterval = 20;
+    conn_opts.cleansession = 1;
+    conn_opts.onSuccess = &on_connect;
+    conn_opts.onFailure = &on_connect_fail;
+    conn_opts.context = &b;
+    conn_opts.username = usr;
+    conn_opts.password = pwd;
+    if (max_inflight > 0) {
+        conn_opts.maxInflight = max_inflight;
+    }
+    if (MQTTAsync_connect(client, &conn_opts) != MQTTASYNC_SUCCESS) {
+        printf("%s\n", "ERROR: Cannot connect");
+        MQTTAsync_destroy(&client);
+        return 1;
+    }
+    double ts = bench_now();
+    while (!UM_ATOMIC_GET(&b.connected) && !UM_ATOMIC_GET(&b.failed) &&
+           bench_now() - ts < BENCH_TIMEOUT) {
+        usleep(1000);
+    }
+    if (!UM_ATOMIC_GET(&b.connected)) {
+        printf("ERROR: Cannot connect to [%s]\n", addr);
+        MQTTAsync_destroy(&client);
+        return 1;
+    }
+
+    // publish
+    char *d = calloc(1, sz + 1);
+    memset(d, 'x', sz);
+    int send_err = 0;
+    ts = bench_now();
+    for (int i = 0; i < n; i++) {
+        int rc;
+        if (qos == 0) {
+            rc = MQTTAsync_send(client, topic, sz, d, 0, 0, NULL);
+        } else {
+            MQTTAsync_responseOptions opts = MQTTAsync_responseOptions_initializer;
+            opts.onSuccess = &on_send;
+            opts.onFailure = &on_send_fail;
+            opts.context = &b;
+            rc = MQTTAsync_send(client, topic, sz, d, qos, 0, &opts);
+        }
+        if (rc != MQTTASYNC_SUCCESS) {
+            send_err++;
+        }
+    }
+    double t_send = bench_now() - ts;
+    // wait for completion (acks or send queue drained)
+    int done = n - send_err;
+    while (bench_now() - ts < BENCH_TIMEOUT) {
+        if (qos == 0 ? bench_pending(client) == 0 : UM_ATOMIC_GET(&b.acked) >= done) {
+            break;
+        }
+        usleep(100);
+    }
+    double t_done = bench_now() - ts;
+
+    // results
+    printf("qos: %d, max_inflight: %d, messages: %d, payload: %d bytes\n",
+           qos,
+           max_inflight,
+           n,
+           sz);
+    printf("send errors: %d, failed: %u, completed: %u\n",
+           send_err,
+           UM_ATOMIC_GET(&b.failed),
+           (qos == 0 ? (uint32_t)done : UM_ATOMIC_GET(&b.acked)));
+    printf("queued:    %.0f msg/s (%.3f s)\n", n / t_send, t_send);
+    printf("completed: %.0f msg/s (%.3f s)\n", n / t_done, t_done);
+
+    // disconnect
+    MQTTAsync_disconnectOptions disc_opts = MQTTAsync_disconnectOptions_initializer;
+    disc_opts.timeout = 1000;
+    MQTTAsync_disconnect(client, &disc_opts);
+    usleep(100000);
+    MQTTAsync_destroy(&client);
+    free(d);
+    return (send_err > 0 || UM_ATOMIC_GET(&b.failed) > 0);
+}
@@ -0,0 +1,135 @@
+/*
+ *               _____  ____ __
+ *   __ ____ _  /  _/ |/ / //_/
+ *  / // /  ' \_/ //    / ,<
+ *  \_,_/_/_/_/___/_/|_/_/|_|
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <umdb.h>
+
+// defaults
+#define BENCH_USERS 1000
+#define BENCH_ITER  100000
+
+static double
+bench_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// create user table with n users (plaintext
+// credentials, user<i>/pwd<i>)
+static int
+bench_db_create(const char *db, int n)
+{
+    sqlite3 *db_p = NULL;
+    if (sqlite3_open(db, &db_p)) {
+        sqlite3_close(db_p);
+        return 1;
+    }
+    sqlite3_stmt *stmt = NULL;
+    int ret = 0;
+    if (sqlite3_exec(db_p,
+                     "CREATE TABLE user (id INTEGER PRIMARY KEY, "
+                     "username TEXT, password TEXT, flags INTEGER); "
+                     "BEGIN",
+                     NULL,
+                     NULL,
+                     NULL) ||
+        sqlite3_prepare_v2(db_p,
+                           "INSERT INTO user (username, password, flags) "
+                           "VALUES (?, ?, 0)",
+                           -1,
+                           &stmt,
+                           NULL)) {
+        sqlite3_close(db_p);
+        return 2;
+    }
+    for (int i = 0; i < n && ret == 0; i++) {
+        char u[32];
+        char p[32];
+        snprintf(u, sizeof(u), "user%d", i);
+        snprintf(p, sizeof(p), "pwd%d", i);
+        if (sqlite3_bind_text(stmt, 1, u, -1, SQLITE_TRANSIENT) ||
+            sqlite3_bind_text(stmt, 2, p, -1, SQLITE_TRANSIENT) ||
+            sqlite3_step(stmt) != SQLITE_DONE) {
+            ret = 3;
+        }
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    if (sqlite3_exec(db_p, "COMMIT", NULL, NULL, NULL) && ret == 0) {
+        ret = 4;
+    }
+    sqlite3_close(db_p);
+    return ret;
+}
+
+// main (umdb_bench [users] [iterations]); each iteration
+// is one umdb_mngr_uauth and one umdb_mngr_uget for a
+// random user, result is reported as lookups/s
+int
+main(int argc, char **argv)
+{
+    int n = (argc > 1 ? atoi(argv[1]) : BENCH_USERS);
+    int iter = (argc > 2 ? atoi(argv[2]) : BENCH_ITER);
+    if (n < 1 || iter < 1) {
+        printf("%s\n", "usage: umdb_bench [users] [iterations]");
+        return 1;
+    }
+    // local SQLite file
+    char db[] = "/tmp/umdb_bench.XXXXXX";
+    int fd = mkstemp(db);
+    if (fd < 0) {
+        printf("%s\n", "ERROR: Cannot create db file");
+        return 1;
+    }
+    close(fd);
+    unlink(db);
+    if (bench_db_create(db, n)) {
+        printf("%s\n", "ERROR: Cannot create user table");
+        unlink(db);
+        return 1;
+    }
+    umdb_mngrd_t *m = umdb_mngr_new(db);
+    if (m == NULL) {
+        printf("%s\n", "ERROR: Cannot open db");
+        unlink(db);
+        return 1;
+    }
+    srand(1);
+    int fails = 0;
+    double ts = bench_now();
+    for (int i = 0; i < iter; i++) {
+        int id = rand() % n;
+        char u[32];
+        char p[32];
+        snprintf(u, sizeof(u), "user%d", id);
+        snprintf(p, sizeof(p), "pwd%d", id);
+        umdb_uauth_d_t res;
+        if (umdb_mngr_uauth(m, &res, u, p) || res.auth != 1) {
+            fails++;
+        }
+        if (umdb_mngr_uget(m, &res, u) || res.id < 1) {
+            fails++;
+        }
+    }
+    double el = bench_now() - ts;
+    printf("users: %d, iterations: %d, failed: %d\n", n, iter, fails);
+    printf("%.0f lookups/s (%.2f us per lookup)\n",
+           (iter * 2) / el,
+           el * 1e6 / (iter * 2));
+    umdb_mngr_free(m);
+    unlink(db);
+    return (fails > 0);
+}
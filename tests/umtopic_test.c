@@ -0,0 +1,81 @@
+/*
+ *               _____  ____ __
+ *   __ ____ _  /  _/ |/ / //_/
+ *  / // /  ' \_/ //    / ,<
+ *  \_,_/_/_/_/___/_/|_/_/|_|
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <umtopic.h>
+
+// number of failed checks
+static int fails = 0;
+
+#define CHECK(expr)                                                    \
+    do {                                                               \
+        if (!(expr)) {                                                 \
+            printf("FAIL: %s:%d: %s\n", __FILE__, __LINE__, #expr);    \
+            fails++;                                                   \
+        }                                                              \
+    } while (0)
+
+static void
+on_match(void *val, void *arg)
+{
+    (void)val;
+    (*(size_t *)arg)++;
+}
+
+// match topic as user/client
+static size_t
+match(umtopic_trie_t *t, const char *topic, const char *u, const char *c)
+{
+    umtopic_subst_t subst[] = { { "%u", u }, { "%c", c } };
+    size_t n = 0;
+    size_t m = umtopic_match_subst(t, topic, strlen(topic), subst, 2, &on_match, &n);
+    return (m == n ? m : (size_t)-1);
+}
+
+int
+main(int argc, char **argv)
+{
+    umtopic_trie_t *t = umtopic_new();
+    CHECK(t != NULL);
+    CHECK(umtopic_add(t, "devices/%u/#", "own") == 0);
+    CHECK(umtopic_add(t, "clients/%c", "client") == 0);
+    CHECK(umtopic_add(t, "public/+", "public") == 0);
+
+    // substituted levels
+    CHECK(match(t, "devices/alice/temp", "alice", "c1") == 1);
+    CHECK(match(t, "devices/bob/temp", "alice", "c1") == 0);
+    CHECK(match(t, "clients/c1", "alice", "c1") == 1);
+    CHECK(match(t, "clients/c2", "alice", "c1") == 0);
+
+    // literal placeholder level does not match
+    // substitution node (any user would be granted)
+    CHECK(match(t, "devices/%u/anything", "alice", "c1") == 0);
+    CHECK(match(t, "clients/%c", "alice", "c1") == 0);
+
+    // user named as placeholder matches own topics only
+    CHECK(match(t, "devices/%u/temp", "%u", "c1") == 1);
+
+    // wildcards still match literal placeholder levels
+    CHECK(match(t, "public/%u", "alice", "c1") == 1);
+
+    // plain match (no substitution) is literal
+    size_t n = 0;
+    const char *topic = "devices/%u/x";
+    CHECK(umtopic_match(t, topic, strlen(topic), &on_match, &n) == 1);
+
+    umtopic_free(t);
+    if (fails > 0) {
+        return EXIT_FAILURE;
+    }
+    printf("%s\n", "umtopic: OK");
+    return EXIT_SUCCESS;
+}